@@ -40,15 +40,59 @@ CREATE TYPE versioned_int (
     storage = extended
 );
 
+-- STABLE, not IMMUTABLE: 'T' policies are read from versioned_int_tier
+-- and 'D' cutoff depends on current time, so the cast must not be folded
 CREATE FUNCTION versioned_int_enforce_modifier(versioned_int, integer)
     RETURNS versioned_int
     AS 'MODULE_PATHNAME'
-    LANGUAGE C IMMUTABLE STRICT;
+    LANGUAGE C STABLE STRICT;
 
 CREATE CAST (versioned_int AS versioned_int)
     WITH FUNCTION versioned_int_enforce_modifier(versioned_int, integer)
     AS IMPLICIT;
 
+-- Tiers of 'T' retention policies. Column declared as versioned_int(1, 'T')
+-- keeps entries older than older_than at bucket resolution, e.g.
+-- (1, '7 days', '1 minute'), (1, '90 days', '1 hour')
+CREATE TABLE versioned_int_tier (
+    policy INTEGER NOT NULL,
+    older_than INTERVAL NOT NULL,
+    bucket INTERVAL NOT NULL,
+    PRIMARY KEY (policy, older_than)
+);
+
+SELECT pg_catalog.pg_extension_config_dump('versioned_int_tier', '');
+
+-- Policies are cached per transaction, changes to the table drop the cache
+CREATE FUNCTION versioned_int_tier_reset()
+    RETURNS trigger
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C;
+
+CREATE TRIGGER versioned_int_tier_reset
+    AFTER INSERT OR UPDATE OR DELETE OR TRUNCATE ON versioned_int_tier
+    FOR EACH STATEMENT EXECUTE FUNCTION versioned_int_tier_reset();
+
+CREATE FUNCTION versioned_int_compact(versioned_int, integer)
+    RETURNS versioned_int
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION versioned_int_set_prefix(versioned_int, boolean)
+    RETURNS versioned_int
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_set_split(versioned_int, integer)
+    RETURNS versioned_int
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_detoast_cache_stats(OUT hits BIGINT, OUT misses BIGINT,
+                                                  OUT entries BIGINT, OUT bytes BIGINT)
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT VOLATILE;
+
 CREATE TYPE ts_int AS (
     ts TIMESTAMPTZ,
     value BIGINT
@@ -66,11 +110,121 @@ CREATE FUNCTION get_history(versioned_int)
     AS 'MODULE_PATHNAME'
     LANGUAGE C STRICT VOLATILE;
 
+CREATE FUNCTION get_history(versioned_int, TSTZRANGE)
+    RETURNS SETOF __int_history
+    AS 'MODULE_PATHNAME', 'get_history_range'
+    LANGUAGE C STRICT VOLATILE;
+
+CREATE FUNCTION versioned_int_slice(versioned_int, TSTZRANGE)
+    RETURNS versioned_int
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_since(versioned_int, TIMESTAMPTZ)
+    RETURNS versioned_int
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
 CREATE FUNCTION versioned_int_at_time(versioned_int, TIMESTAMPTZ)
     RETURNS BIGINT
     AS 'MODULE_PATHNAME'
     LANGUAGE C STRICT IMMUTABLE;
 
+CREATE FUNCTION versioned_int_at_times(versioned_int, TIMESTAMPTZ[])
+    RETURNS BIGINT[]
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_twa(versioned_int, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_integral(versioned_int, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_min(versioned_int, TSTZRANGE)
+    RETURNS BIGINT
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_max(versioned_int, TSTZRANGE)
+    RETURNS BIGINT
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_first(versioned_int, TSTZRANGE)
+    RETURNS BIGINT
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_last(versioned_int, TSTZRANGE)
+    RETURNS BIGINT
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_resample(versioned_int, TIMESTAMPTZ, INTERVAL, TIMESTAMPTZ, TIMESTAMPTZ, TEXT DEFAULT 'at')
+    RETURNS TABLE (bucket TIMESTAMPTZ, value BIGINT)
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_lttb(versioned_int, INTEGER, TSTZRANGE DEFAULT '(,)',
+                                   OUT times TIMESTAMPTZ[], OUT vals BIGINT[])
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_minmax_downsample(versioned_int, INTEGER, TSTZRANGE DEFAULT '(,)',
+                                                OUT times TIMESTAMPTZ[], OUT vals BIGINT[])
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_percentile(versioned_int, TSTZRANGE, FLOAT8[])
+    RETURNS BIGINT[]
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_histogram(versioned_int, TSTZRANGE, BIGINT[])
+    RETURNS FLOAT8[]
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_increase(versioned_int, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_rate(versioned_int, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_irate(versioned_int, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_int_first_when(versioned_int, TEXT, BIGINT, TIMESTAMPTZ DEFAULT '-infinity')
+    RETURNS TIMESTAMPTZ
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_intervals_when(versioned_int, TEXT, BIGINT)
+    RETURNS TSTZMULTIRANGE
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_times_of(versioned_int, BIGINT)
+    RETURNS TSTZMULTIRANGE
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_set_value_index(versioned_int, boolean)
+    RETURNS versioned_int
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
 CREATE FUNCTION versioned_int_at_time_eq(versioned_int, ts_int)
     RETURNS BOOLEAN
     AS 'MODULE_PATHNAME'
@@ -246,12 +400,74 @@ RETURNS bigint
 AS 'MODULE_PATHNAME'
 LANGUAGE C STRICT IMMUTABLE;
 
+CREATE FUNCTION versioned_int_zip_add(versioned_int, versioned_int)
+RETURNS versioned_int
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_zip_sub(versioned_int, versioned_int)
+RETURNS versioned_int
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_zip_mul(versioned_int, versioned_int)
+RETURNS versioned_int
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_zip_div(versioned_int, versioned_int)
+RETURNS versioned_int
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_sum_series_trans(internal, versioned_int)
+RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION versioned_int_sum_series_combine(internal, internal)
+RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION versioned_int_sum_series_serialize(internal)
+RETURNS bytea
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION versioned_int_sum_series_deserialize(bytea, internal)
+RETURNS internal
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
+
+CREATE FUNCTION versioned_int_sum_series_final(internal)
+RETURNS versioned_int
+AS 'MODULE_PATHNAME'
+LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE versioned_int_sum_series(versioned_int) (
+    SFUNC = versioned_int_sum_series_trans,
+    STYPE = internal,
+    FINALFUNC = versioned_int_sum_series_final,
+    FINALFUNC_MODIFY = READ_WRITE,
+    COMBINEFUNC = versioned_int_sum_series_combine,
+    SERIALFUNC = versioned_int_sum_series_serialize,
+    DESERIALFUNC = versioned_int_sum_series_deserialize,
+    PARALLEL = SAFE
+);
+
 CREATE OPERATOR @ (
     LEFTARG = versioned_int,
     RIGHTARG = TIMESTAMPTZ,
     PROCEDURE = versioned_int_at_time
 );
 
+CREATE OPERATOR @ (
+    LEFTARG = versioned_int,
+    RIGHTARG = TIMESTAMPTZ[],
+    PROCEDURE = versioned_int_at_times
+);
+
 CREATE OPERATOR @= (
     LEFTARG = versioned_int,
     RIGHTARG = ts_int,
@@ -292,6 +508,101 @@ CREATE OPERATOR @>= (
     JOIN = scalargtjoinsel
 );
 
+CREATE TYPE verint_point;
+
+CREATE FUNCTION verint_point_in(cstring)
+    RETURNS verint_point
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION verint_point_out(verint_point)
+    RETURNS cstring
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+-- An untyped '(timestamp,value)' literal matches both the ts_int and the
+-- verint_point overloads of @= and friends, so it needs an explicit cast,
+-- like v @= '(2024-01-01,5)'::verint_point, or verint_point(ts, value)
+CREATE TYPE verint_point (
+    internallength = 16,
+    input = verint_point_in,
+    output = verint_point_out,
+    alignment = double,
+    category = 'U'
+);
+
+CREATE FUNCTION verint_point(TIMESTAMPTZ, BIGINT)
+    RETURNS verint_point
+    AS 'MODULE_PATHNAME', 'verint_point_make'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE CAST (ts_int AS verint_point) WITH INOUT;
+
+CREATE FUNCTION versioned_int_at_point_eq(versioned_int, verint_point)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_at_point_lt(versioned_int, verint_point)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_at_point_gt(versioned_int, verint_point)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_at_point_le(versioned_int, verint_point)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_int_at_point_ge(versioned_int, verint_point)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OPERATOR @= (
+    LEFTARG = versioned_int,
+    RIGHTARG = verint_point,
+    PROCEDURE = versioned_int_at_point_eq,
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel
+);
+
+CREATE OPERATOR @< (
+    LEFTARG = versioned_int,
+    RIGHTARG = verint_point,
+    PROCEDURE = versioned_int_at_point_lt,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR @> (
+    LEFTARG = versioned_int,
+    RIGHTARG = verint_point,
+    PROCEDURE = versioned_int_at_point_gt,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR @<= (
+    LEFTARG = versioned_int,
+    RIGHTARG = verint_point,
+    PROCEDURE = versioned_int_at_point_le,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR @>= (
+    LEFTARG = versioned_int,
+    RIGHTARG = verint_point,
+    PROCEDURE = versioned_int_at_point_ge,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
 CREATE OPERATOR = (
     LEFTARG = versioned_int,
     RIGHTARG = bigint,
@@ -550,6 +861,38 @@ CREATE OPERATOR / (
     PROCEDURE = versioned_int_div_versioned_int
 );
 
+CREATE OPERATOR @? (
+    LEFTARG = versioned_int,
+    RIGHTARG = bigint,
+    PROCEDURE = versioned_int_times_of
+);
+
+CREATE OPERATOR +~ (
+    LEFTARG = versioned_int,
+    RIGHTARG = versioned_int,
+    PROCEDURE = versioned_int_zip_add,
+    COMMUTATOR = +~
+);
+
+CREATE OPERATOR -~ (
+    LEFTARG = versioned_int,
+    RIGHTARG = versioned_int,
+    PROCEDURE = versioned_int_zip_sub
+);
+
+CREATE OPERATOR *~ (
+    LEFTARG = versioned_int,
+    RIGHTARG = versioned_int,
+    PROCEDURE = versioned_int_zip_mul,
+    COMMUTATOR = *~
+);
+
+CREATE OPERATOR /~ (
+    LEFTARG = versioned_int,
+    RIGHTARG = versioned_int,
+    PROCEDURE = versioned_int_zip_div
+);
+
 CREATE OR REPLACE FUNCTION versioned_int_consistent(internal, versioned_int, smallint, oid, internal)
 RETURNS bool
 AS 'MODULE_PATHNAME'
@@ -606,6 +949,11 @@ CREATE OPERATOR CLASS gist_versioned_int_ops
         OPERATOR        3           @> (versioned_int, ts_int),
         OPERATOR        4           @<= (versioned_int, ts_int),
         OPERATOR        5           @>= (versioned_int, ts_int),
+        OPERATOR        6           @= (versioned_int, verint_point),
+        OPERATOR        7           @< (versioned_int, verint_point),
+        OPERATOR        8           @> (versioned_int, verint_point),
+        OPERATOR        9           @<= (versioned_int, verint_point),
+        OPERATOR        10          @>= (versioned_int, verint_point),
         FUNCTION        1           versioned_int_consistent,
         FUNCTION        2           versioned_int_union,
         FUNCTION        3           versioned_int_compress,
@@ -626,4 +974,445 @@ CREATE OPERATOR CLASS versioned_int_ops
     OPERATOR 3  =  (versioned_int, versioned_int) ,
     OPERATOR 4  >= (versioned_int, versioned_int) ,
     OPERATOR 5  >  (versioned_int, versioned_int) ,
-    FUNCTION 1  versioned_int_btree_cmp(versioned_int, versioned_int);
\ No newline at end of file
+    FUNCTION 1  versioned_int_btree_cmp(versioned_int, versioned_int);
+
+CREATE TYPE versioned_row;
+
+CREATE FUNCTION versioned_row_in(cstring)
+    RETURNS versioned_row
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_row_out(versioned_row)
+    RETURNS cstring
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE TYPE versioned_row (
+    internallength = VARIABLE,
+    input = versioned_row_in,
+    output = versioned_row_out,
+    alignment = double,
+    storage = extended
+);
+
+CREATE FUNCTION make_versioned_row(versioned_row, VARIADIC BIGINT[])
+    RETURNS versioned_row
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C VOLATILE;
+
+CREATE FUNCTION make_versioned_row_with_ts(versioned_row, BIGINT[], TIMESTAMPTZ)
+    RETURNS versioned_row
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C VOLATILE;
+
+CREATE FUNCTION versioned_row_at_time(versioned_row, TIMESTAMPTZ)
+    RETURNS BIGINT[]
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_row_populate(anyelement, versioned_row, TIMESTAMPTZ)
+    RETURNS anyelement
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STABLE;
+
+CREATE FUNCTION versioned_row_column(versioned_row, INTEGER)
+    RETURNS versioned_int
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OPERATOR @ (
+    LEFTARG = versioned_row,
+    RIGHTARG = TIMESTAMPTZ,
+    PROCEDURE = versioned_row_at_time
+);
+
+
+CREATE TYPE versioned_float8;
+
+CREATE FUNCTION versioned_float8_in(cstring)
+    RETURNS versioned_float8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_out(versioned_float8)
+    RETURNS cstring
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE TYPE versioned_float8 (
+    internallength = VARIABLE,
+    input = versioned_float8_in,
+    output = versioned_float8_out,
+    typmod_in = versioned_int_typemod_in,
+    typmod_out = versioned_int_typemod_out,
+    alignment = double,
+    storage = extended
+);
+
+-- STABLE for the same reason as versioned_int_enforce_modifier
+CREATE FUNCTION versioned_float8_enforce_modifier(versioned_float8, integer)
+    RETURNS versioned_float8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STABLE STRICT;
+
+CREATE CAST (versioned_float8 AS versioned_float8)
+    WITH FUNCTION versioned_float8_enforce_modifier(versioned_float8, integer)
+    AS IMPLICIT;
+
+CREATE FUNCTION make_versioned_float8(versioned_float8, FLOAT8)
+    RETURNS versioned_float8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C VOLATILE;
+
+CREATE FUNCTION make_versioned_float8_with_ts(versioned_float8, FLOAT8, TIMESTAMPTZ)
+    RETURNS versioned_float8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C VOLATILE;
+
+CREATE FUNCTION versioned_float8_at_time(versioned_float8, TIMESTAMPTZ)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OPERATOR @ (
+    LEFTARG = versioned_float8,
+    RIGHTARG = TIMESTAMPTZ,
+    PROCEDURE = versioned_float8_at_time
+);
+
+CREATE TYPE __float8_history AS (updated_at TIMESTAMPTZ, value FLOAT8);
+
+CREATE FUNCTION get_history(versioned_float8)
+    RETURNS SETOF __float8_history
+    AS 'MODULE_PATHNAME', 'get_float8_history'
+    LANGUAGE C STRICT VOLATILE;
+
+
+CREATE FUNCTION get_history(versioned_float8, TSTZRANGE)
+    RETURNS SETOF __float8_history
+    AS 'MODULE_PATHNAME', 'get_float8_history_range'
+    LANGUAGE C STRICT VOLATILE;
+
+-- Plain histories are valid versioned_float8 values too, so these share
+-- versioned_int's C functions
+CREATE FUNCTION versioned_float8_slice(versioned_float8, TSTZRANGE)
+    RETURNS versioned_float8
+    AS 'MODULE_PATHNAME', 'versioned_int_slice'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_float8_since(versioned_float8, TIMESTAMPTZ)
+    RETURNS versioned_float8
+    AS 'MODULE_PATHNAME', 'versioned_int_since'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_float8_twa(versioned_float8, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_float8_integral(versioned_float8, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_float8_min(versioned_float8, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_float8_max(versioned_float8, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_float8_first(versioned_float8, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_float8_last(versioned_float8, TSTZRANGE)
+    RETURNS FLOAT8
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT STABLE;
+
+CREATE FUNCTION versioned_float8_eq_float8(versioned_float8, FLOAT8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_neq_float8(versioned_float8, FLOAT8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_gt_float8(versioned_float8, FLOAT8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_ge_float8(versioned_float8, FLOAT8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_lt_float8(versioned_float8, FLOAT8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_le_float8(versioned_float8, FLOAT8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OPERATOR = (
+    LEFTARG = versioned_float8,
+    RIGHTARG = float8,
+    PROCEDURE = versioned_float8_eq_float8,
+    NEGATOR = '<>',
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel
+);
+
+CREATE OPERATOR <> (
+    LEFTARG = versioned_float8,
+    RIGHTARG = float8,
+    PROCEDURE = versioned_float8_neq_float8,
+    NEGATOR = '=',
+    RESTRICT = neqsel,
+    JOIN = neqjoinsel
+);
+
+CREATE OPERATOR > (
+    LEFTARG = versioned_float8,
+    RIGHTARG = float8,
+    PROCEDURE = versioned_float8_gt_float8,
+    NEGATOR = <=,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR >= (
+    LEFTARG = versioned_float8,
+    RIGHTARG = float8,
+    PROCEDURE = versioned_float8_ge_float8,
+    NEGATOR = <,
+    RESTRICT = scalargesel,
+    JOIN = scalargejoinsel
+);
+
+CREATE OPERATOR < (
+    LEFTARG = versioned_float8,
+    RIGHTARG = float8,
+    PROCEDURE = versioned_float8_lt_float8,
+    NEGATOR = >=,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <= (
+    LEFTARG = versioned_float8,
+    RIGHTARG = float8,
+    PROCEDURE = versioned_float8_le_float8,
+    NEGATOR = >,
+    RESTRICT = scalarlesel,
+    JOIN = scalarlejoinsel
+);
+
+-- Keys stored for floats order like floats, so comparing two histories
+-- is the same as for versioned_int
+
+CREATE FUNCTION versioned_float8_eq_versioned_float8(versioned_float8, versioned_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME', 'versioned_int_eq_versioned_int'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_neq_versioned_float8(versioned_float8, versioned_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME', 'versioned_int_neq_versioned_int'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_gt_versioned_float8(versioned_float8, versioned_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME', 'versioned_int_gt_versioned_int'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_ge_versioned_float8(versioned_float8, versioned_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME', 'versioned_int_ge_versioned_int'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_lt_versioned_float8(versioned_float8, versioned_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME', 'versioned_int_lt_versioned_int'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE FUNCTION versioned_float8_le_versioned_float8(versioned_float8, versioned_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME', 'versioned_int_le_versioned_int'
+    LANGUAGE C IMMUTABLE STRICT;
+
+CREATE OPERATOR = (
+    LEFTARG    = versioned_float8,
+    RIGHTARG   = versioned_float8,
+    PROCEDURE  = versioned_float8_eq_versioned_float8,
+    COMMUTATOR = '=',
+    NEGATOR    = '<>',
+    RESTRICT   = eqsel,
+    JOIN       = eqjoinsel
+);
+
+CREATE OPERATOR <> (
+    LEFTARG    = versioned_float8,
+    RIGHTARG   = versioned_float8,
+    PROCEDURE  = versioned_float8_neq_versioned_float8,
+    COMMUTATOR = '<>',
+    NEGATOR    = '=',
+    RESTRICT   = neqsel,
+    JOIN       = neqjoinsel
+);
+
+CREATE OPERATOR > (
+    LEFTARG    = versioned_float8,
+    RIGHTARG   = versioned_float8,
+    PROCEDURE  = versioned_float8_gt_versioned_float8,
+    COMMUTATOR = <,
+    NEGATOR    = <=,
+    RESTRICT   = scalargtsel,
+    JOIN       = scalargtjoinsel
+);
+
+CREATE OPERATOR >= (
+    LEFTARG    = versioned_float8,
+    RIGHTARG   = versioned_float8,
+    PROCEDURE  = versioned_float8_ge_versioned_float8,
+    COMMUTATOR = <=,
+    NEGATOR    = <,
+    RESTRICT   = scalargesel,
+    JOIN       = scalargejoinsel
+);
+
+CREATE OPERATOR < (
+    LEFTARG    = versioned_float8,
+    RIGHTARG   = versioned_float8,
+    PROCEDURE  = versioned_float8_lt_versioned_float8,
+    COMMUTATOR = >,
+    NEGATOR    = >=,
+    RESTRICT   = scalarltsel,
+    JOIN       = scalarltjoinsel
+);
+
+CREATE OPERATOR <= (
+    LEFTARG    = versioned_float8,
+    RIGHTARG   = versioned_float8,
+    PROCEDURE  = versioned_float8_le_versioned_float8,
+    COMMUTATOR = >=,
+    NEGATOR    = >,
+    RESTRICT   = scalarlesel,
+    JOIN       = scalarlejoinsel
+);
+
+CREATE FUNCTION versioned_float8_btree_cmp(versioned_float8, versioned_float8)
+    RETURNS integer
+    AS 'MODULE_PATHNAME', 'versioned_int_btree_cmp'
+    LANGUAGE C STRICT;
+
+CREATE OPERATOR CLASS versioned_float8_ops
+    DEFAULT FOR TYPE versioned_float8 USING btree AS
+    OPERATOR 1  <  (versioned_float8, versioned_float8) ,
+    OPERATOR 2  <= (versioned_float8, versioned_float8) ,
+    OPERATOR 3  =  (versioned_float8, versioned_float8) ,
+    OPERATOR 4  >= (versioned_float8, versioned_float8) ,
+    OPERATOR 5  >  (versioned_float8, versioned_float8) ,
+    FUNCTION 1  versioned_float8_btree_cmp(versioned_float8, versioned_float8);
+
+CREATE TYPE ts_float8 AS (
+    ts TIMESTAMPTZ,
+    value FLOAT8
+);
+
+CREATE FUNCTION versioned_float8_at_time_eq(versioned_float8, ts_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_float8_at_time_lt(versioned_float8, ts_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_float8_at_time_gt(versioned_float8, ts_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_float8_at_time_le(versioned_float8, ts_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE FUNCTION versioned_float8_at_time_ge(versioned_float8, ts_float8)
+    RETURNS BOOLEAN
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT IMMUTABLE;
+
+CREATE OPERATOR @= (
+    LEFTARG = versioned_float8,
+    RIGHTARG = ts_float8,
+    PROCEDURE = versioned_float8_at_time_eq,
+    RESTRICT = eqsel,
+    JOIN = eqjoinsel
+);
+
+CREATE OPERATOR @< (
+    LEFTARG = versioned_float8,
+    RIGHTARG = ts_float8,
+    PROCEDURE = versioned_float8_at_time_lt,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR @> (
+    LEFTARG = versioned_float8,
+    RIGHTARG = ts_float8,
+    PROCEDURE = versioned_float8_at_time_gt,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR @<= (
+    LEFTARG = versioned_float8,
+    RIGHTARG = ts_float8,
+    PROCEDURE = versioned_float8_at_time_le,
+    RESTRICT = scalarltsel,
+    JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR @>= (
+    LEFTARG = versioned_float8,
+    RIGHTARG = ts_float8,
+    PROCEDURE = versioned_float8_at_time_ge,
+    RESTRICT = scalargtsel,
+    JOIN = scalargtjoinsel
+);
+
+CREATE FUNCTION versioned_float8_consistent(internal, versioned_float8, smallint, oid, internal)
+    RETURNS bool
+    AS 'MODULE_PATHNAME'
+    LANGUAGE C STRICT;
+
+CREATE OPERATOR CLASS gist_versioned_float8_ops
+    DEFAULT FOR TYPE versioned_float8 USING gist AS
+        OPERATOR        1           @= (versioned_float8, ts_float8),
+        OPERATOR        2           @< (versioned_float8, ts_float8),
+        OPERATOR        3           @> (versioned_float8, ts_float8),
+        OPERATOR        4           @<= (versioned_float8, ts_float8),
+        OPERATOR        5           @>= (versioned_float8, ts_float8),
+        FUNCTION        1           versioned_float8_consistent,
+        FUNCTION        2           versioned_int_union,
+        FUNCTION        3           versioned_int_compress,
+        FUNCTION        5           versioned_int_penalty,
+        FUNCTION        6           versioned_int_picksplit,
+        FUNCTION        7           versioned_int_same,
+        STORAGE verint_rect;
@@ -1,18 +1,48 @@
 #include "postgres.h"
+
+#include <ctype.h>
+#include <math.h>
+
 #include "fmgr.h"
 #include "datatype/timestamp.h"
 #include "utils/timestamp.h"
 #include "funcapi.h"
 #include "access/gist.h"
 #include "access/heapam.h"
+#include "access/detoast.h"
+#include "access/toast_compression.h"
+#include "access/heaptoast.h"
 #include "nodes/nodeFuncs.h"
+#include "catalog/pg_type.h"
 #include "utils/array.h"
+#include "utils/rangetypes.h"
+#include "utils/multirangetypes.h"
+#include "common/int.h"
+#include "common/pg_lzcompress.h"
+#include "lib/stringinfo.h"
+#include "port/pg_bitutils.h"
+#include "utils/float.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/typcache.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "lib/ilist.h"
+#include "access/htup_details.h"
+#include "executor/spi.h"
+#include "commands/trigger.h"
 
 #define MAX_VERSIONED_INT_SIZE (512 * 1024 * 1024)
 #define VERINT_MODIFIER_MAX_VALUE (1 << 24)
 #define MODIFIER_CHARSHIFT (24)
 #define LEN_MASK ((1 << MODIFIER_CHARSHIFT) - 1)
 
+/* Integrals are accumulated exactly, in value * microseconds */
+#ifndef HAVE_INT128
+#error "versioned_int requires 128 bit integer support"
+#endif
+
 #ifdef PG_MODULE_MAGIC
 PG_MODULE_MAGIC;
 #endif
@@ -35,9 +65,8 @@ typedef struct
  * v1_len_ is mandatory field for varlena types that holds total length in bytes
  * count is number of entries in entries array
  * cap is current capacity of entries array
- * pad_ is padding added for aligning entries array
- * entries is an array that holds integer's history
- * min_val and max_val are fields used to speed inserting entry in gist index
+ * flags holds VERINT_FLAG_* bits. It also keeps entries array aligned.
+ * entries is an array that holds integer's history, oldest entry first
  *
  */
 typedef struct
@@ -45,21 +74,122 @@ typedef struct
     int32 v1_len_;
     int32 count;
     int32 cap;
-    int32 pad_;
+    int32 flags;
     VersionedIntEntry entries[FLEXIBLE_ARRAY_MEMBER];
 } VersionedInt;
 
+/*
+ * VERINT_FLAG_BOUNDED marks value whose cap equals the column's 'N'
+ * retention. Appends never overwrite it: a full bounded value grows by a
+ * single slot and the column's enforcement drops the oldest entry, so a
+ * value copied out of its column loses nothing.
+ *
+ * VERINT_FLAG_PREFIX marks value that carries, right after its entries,
+ * int128 array of cap slots parallel to entries. Slot of entry i holds
+ * integral (value * microseconds) of history from its first entry up to
+ * entry i's time, so integral over any range is a difference of two
+ * lookups. Integrals are exact, so the difference equals what a sweep
+ * over the range sums.
+ * Prefixes are relative, evicting oldest entries doesn't invalidate
+ * them.
+ *
+ * VERINT_FLAG_VALUE_INDEX marks value that carries, after its entries and
+ * prefixes, int32 array of cap slots holding indexes of entries
+ * sorted by (value, time), so times at which history held a value are
+ * found by binary search.
+ *
+ * Side arrays are layout flags, they travel with the value through every
+ * function that rebuilds it.
+ *
+ * VERINT_FLAG_DICT marks dictionary encoded value, see VersionedIntDict.
+ *
+ * VERINT_FLAG_SPLIT marks value split into cold blocks and hot tail, see
+ * VersionedIntSplit. Split value carries no side arrays and is never
+ * bounded, 'N' retention trims it by skipping into its cold blocks.
+ *
+ * VERINT_FLAG_XOR marks Gorilla encoded value, see VersionedIntXor.
+ */
+#define VERINT_FLAG_BOUNDED 0x01
+#define VERINT_FLAG_PREFIX 0x02
+#define VERINT_FLAG_VALUE_INDEX 0x04
+#define VERINT_FLAG_DICT 0x08
+#define VERINT_FLAG_SPLIT 0x10
+#define VERINT_FLAG_XOR 0x20
+#define VERINT_LAYOUT_MASK (VERINT_FLAG_PREFIX | VERINT_FLAG_VALUE_INDEX)
+
+#define VERINT_HDRSZ offsetof(VersionedInt, entries)
+#define VERINT_SLOT_SIZE(flags)                                              \
+    (sizeof(VersionedIntEntry) +                                             \
+     (((flags) & VERINT_FLAG_PREFIX) ? sizeof(int128) : 0) +                 \
+     (((flags) & VERINT_FLAG_VALUE_INDEX) ? sizeof(int32) : 0))
+#define VERINT_SIZE(cap, flags) (VERINT_HDRSZ + (Size)(cap) * VERINT_SLOT_SIZE(flags))
+#define VERINT_PREFIX(v) ((int128 *)&(v)->entries[(v)->cap])
+#define VERINT_VALUE_INDEX(v) \
+    ((int32 *)((char *)&(v)->entries[(v)->cap] + \
+               ((VERINT_FLAGS(v) & VERINT_FLAG_PREFIX) ? (Size)(v)->cap * sizeof(int128) : 0)))
+
 /*
  *
- * Helper struct that holds values array and nulls array required
- * for specifying return in srfs.
+ * Dictionary encoded form of versioned_int, written instead of plain one
+ * when history holds at most VERINT_DICT_MAX distinct values. Header is
+ * shared with VersionedInt. data holds dictionary of
+ * ndict values, then count entry times, then count codes of bits bits
+ * each, packed from lowest bits of a byte. Codes have fixed width and
+ * never straddle bytes, so any entry is decoded in O(1).
  *
  */
 typedef struct
 {
-    Datum values[2];
-    bool nulls[2];
-} NullsAndValues;
+    int32 v1_len_;
+    int32 count;
+    int32 cap;
+    int32 flags;
+    int32 ndict;
+    int32 bits;
+    int64 data[FLEXIBLE_ARRAY_MEMBER];
+} VersionedIntDict;
+
+#define VERINT_DICT_MAX 16
+#define VERINT_DICT_MIN_COUNT 32
+#define VERINT_DICT_TIMES(d) ((TimestampTz *)&(d)->data[(d)->ndict])
+#define VERINT_DICT_CODES(d) ((uint8 *)&(d)->data[(d)->ndict + (d)->count])
+#define VERINT_DICT_SIZE(ndict, count, bits) \
+    (offsetof(VersionedIntDict, data) + ((Size)(ndict) + (count)) * sizeof(int64) + ((Size)(count) * (bits) + 7) / 8)
+
+/*
+ *
+ * Split form of versioned_int, for histories that are appended to and
+ * read mostly at their end. Newest entries live in a raw tail of up to
+ * tail_cap entries, starting at tail_offset bytes into the datum. When
+ * tail fills up, the next append seals it into a pglz compressed block
+ * of exactly tail_cap entries; blocks are never touched again. Block k
+ * holds entries [k * tail_cap - skip, (k + 1) * tail_cap - skip) and
+ * spans offsets[k] to offsets[k + 1] bytes after the offsets array. First
+ * skip entries of block 0 were trimmed away by retention and are no
+ * longer part of the value. A block that didn't compress is stored raw. Header is shared with VersionedInt, with cap
+ * equal to count. With EXTERNAL storage, appends copy cold
+ * blocks without decoding them and tail reads are slices of the tail.
+ *
+ */
+typedef struct
+{
+    int32 v1_len_;
+    int32 count;
+    int32 cap;
+    int32 flags;
+    int32 tail_cap;
+    int32 tail_offset;
+    int32 nblocks;
+    int32 skip;
+    int32 offsets[FLEXIBLE_ARRAY_MEMBER];
+} VersionedIntSplit;
+
+#define VERINT_SPLIT_HDRSZ offsetof(VersionedIntSplit, offsets)
+#define VERINT_SPLIT_BLOCKS(nblocks) (VERINT_SPLIT_HDRSZ + ((Size)(nblocks) + 1) * sizeof(int32))
+#define VERINT_SPLIT_COLD(s) ((s)->nblocks * (s)->tail_cap - (s)->skip)
+#define VERINT_SPLIT_TAIL(s) ((VersionedIntEntry *)((char *)(s) + (s)->tail_offset))
+
+#define VERINT_FLAGS(v) ((v)->flags)
 
 /*
  *
@@ -82,6 +212,315 @@ typedef struct
     int64 verint_max;
 } VerintMinMax;
 
+/*
+ *
+ * Reader over versioned_int datum that may still be toasted. Values stored
+ * externally without compression are read through slices, so only
+ * header and requested entries are ever fetched. Any other value is
+ * detoasted in full and hdr points to the whole versioned_int. Dictionary
+ * encoded and split values are read in place, decoding only requested
+ * entries; split reader keeps the last cold block it decompressed.
+ * Gorilla encoded values can only be decoded from their start, so they
+ * are decoded whole and read as plain ones.
+ *
+ */
+typedef struct
+{
+    Datum datum;
+    VersionedInt *hdr;
+    VersionedIntDict *dict;
+    VersionedIntSplit *split;
+    VersionedIntEntry *cold;
+    int32 coldBlock;
+    bool sliced;
+} VerintReader;
+
+/* Number of entries fetched at once when streaming a sliced range */
+#define VERINT_READER_BATCH 1024
+
+/*
+ * Number of trailing entries fetched first by point lookups on sliced
+ * values. Window doubles every time target time lies before it.
+ */
+#define VERINT_TAIL_WINDOW 64
+
+/*
+ *
+ * Probe time of a batch lookup along with its position in input array,
+ * so results can be written back in input order after probes are sorted.
+ *
+ */
+typedef struct
+{
+    TimestampTz time;
+    int32 idx;
+} VerintProbe;
+
+/*
+ *
+ * Cumulative duration a percentile must reach, along with position of its
+ * fraction in input array.
+ *
+ */
+typedef struct
+{
+    int64 weight;
+    int32 idx;
+} VerintThreshold;
+
+/*
+ *
+ * Transition state of versioned_int_sum_series. Every input contributes
+ * (time, delta) events, value field holding change of input's value at
+ * that time. Events are appended unsorted and compacted (sorted, with
+ * events sharing a timestamp summed) whenever their count doubles since
+ * previous compaction, so series sampled on a common grid stay small.
+ *
+ */
+typedef struct
+{
+    VersionedIntEntry *deltas;
+    int64 count;
+    int64 cap;
+    int64 compacted;
+} VerintSumState;
+
+#define VERINT_SUM_INITIAL_CAP 1024
+
+/*
+ *
+ * Aggregates of versioned_int viewed as a step function over a time range.
+ * integral is exact sum of value * microseconds value was held, covered is number
+ * of microseconds of range during which versioned_int existed. first and
+ * last are values in effect at start and end of covered part of range.
+ * For versioned_float8 min, max, first and last are keys of values and
+ * float_integral takes place of integral.
+ *
+ */
+typedef struct
+{
+    int128 integral;
+    float8 float_integral;
+    int64 covered;
+    int64 min;
+    int64 max;
+    int64 first;
+    int64 last;
+} VerintRangeStats;
+
+/*
+ *
+ * Summary of a counter's samples within a range, as needed by rate,
+ * increase and irate. increase is sum of deltas between consecutive
+ * samples, with a drop in value counted as reset to zero.
+ *
+ */
+typedef struct
+{
+    int32 count;
+    TimestampTz from;
+    TimestampTz to;
+    VersionedIntEntry first;
+    VersionedIntEntry prev;
+    VersionedIntEntry last;
+    float8 increase;
+} VerintCounterStats;
+
+/*
+ *
+ * Comparison operators accepted by predicate search functions.
+ *
+ */
+typedef enum
+{
+    VERINT_OP_LT,
+    VERINT_OP_LE,
+    VERINT_OP_EQ,
+    VERINT_OP_NE,
+    VERINT_OP_GE,
+    VERINT_OP_GT
+} VerintOp;
+
+/*
+ *
+ * Value held for duration microseconds, one per step of history within
+ * a range. Used by duration weighted distribution functions.
+ *
+ */
+typedef struct
+{
+    int64 value;
+    int64 duration;
+} VerintStep;
+
+/*
+ *
+ * Single tier of a 'T' retention policy, as declared in versioned_int_tier
+ * table. Entries older than older_than microseconds are kept at bucket
+ * resolution (min, max and last entry of every bucket).
+ *
+ */
+typedef struct
+{
+    int64 older_than;
+    int64 bucket;
+} VerintTier;
+
+/*
+ *
+ * All tiers of one policy ordered by older_than ascending. Loaded once per
+ * transaction and kept in list tier_policies.
+ *
+ */
+typedef struct VerintTierPolicy
+{
+    int32 policy;
+    int32 ntiers;
+    struct VerintTierPolicy *next;
+    VerintTier tiers[FLEXIBLE_ARRAY_MEMBER];
+} VerintTierPolicy;
+
+/*
+ *
+ * Struct that is versioned_row's internal representation, history of
+ * several integer columns that always change together.
+ * v1_len_ is mandatory field for varlena types that holds total length in bytes
+ * count is number of rows in history
+ * cap is current capacity of times array
+ * ncols is number of value columns, fixed by the first write
+ * times holds one timestamp per row, shared by all columns, followed by
+ * cap rows of ncols values each, so a snapshot is one binary search over
+ * times and one contiguous read of values.
+ *
+ */
+typedef struct
+{
+    int32 v1_len_;
+    int32 count;
+    int32 cap;
+    int32 ncols;
+    TimestampTz times[FLEXIBLE_ARRAY_MEMBER];
+} VersionedRow;
+
+#define VERROW_HDRSZ offsetof(VersionedRow, times)
+#define VERROW_SIZE(cap, ncols) \
+    (VERROW_HDRSZ + (Size)(cap) * (sizeof(TimestampTz) + (Size)(ncols) * sizeof(int64)))
+#define VERROW_VALUES(r, i) ((int64 *)&(r)->times[(r)->cap] + (Size)(i) * (r)->ncols)
+
+/*
+ *
+ * Value types histories are kept for. versioned_float8 shares storage
+ * with versioned_int: its entries hold verfloat_key of each value, an
+ * int64 that orders like the float it stands for, so storage, search,
+ * retention, GiST and comparison kernels work on it unchanged. Kernels
+ * that do depend on value type take it as a constant argument of a
+ * pg_attribute_always_inline function, which the compiler specializes
+ * per type; SQL functions are thin wrappers passing their type.
+ *
+ */
+typedef enum
+{
+    VERINT_INT8,
+    VERINT_FLOAT8
+} VerintValueType;
+
+/*
+ *
+ * Codec state after an entry of Gorilla stream, i.e. everything needed
+ * to encode or decode the next one: its time, distance from previous
+ * entry's time, its value and leading/trailing zero counts of last
+ * explicitly written XOR window (-1 while there is none).
+ *
+ */
+typedef struct
+{
+    TimestampTz time;
+    int64 delta;
+    uint64 value;
+    int32 leading;
+    int32 trailing;
+} VerintXorState;
+
+/*
+ *
+ * Gorilla encoded form of versioned_int, written for versioned_float8
+ * whose values XOR well against each other. Header is shared with
+ * VersionedInt, with cap equal to count. data is a bit stream of nbits
+ * bits, most significant bit of a byte first, holding skip + count
+ * entries of which first skip were trimmed away by retention and are no
+ * longer part of the value. First entry is written as raw time and
+ * value, each following one as delta of delta of its time and XOR of its
+ * value with previous value. state is codec state after the last entry,
+ * so appends continue the stream and current value is read without
+ * decoding it.
+ *
+ * Time delta of delta, zigzag encoded:
+ *   '0'                  delta of delta is 0
+ *   '10'   + 14 bits
+ *   '110'  + 24 bits
+ *   '1110' + 36 bits
+ *   '1111' + 64 bits
+ *
+ * Value XOR:
+ *   '0'                  same value as previous entry
+ *   '10'   + bits        meaningful bits fit in previous window
+ *   '11'   + 6 bits leading zeros + 6 bits length - 1 + bits
+ *
+ */
+typedef struct
+{
+    int32 v1_len_;
+    int32 count;
+    int32 cap;
+    int32 flags;
+    int64 nbits;
+    int32 skip;
+    VerintXorState state;
+    uint8 data[FLEXIBLE_ARRAY_MEMBER];
+} VersionedIntXor;
+
+#define VERINT_XOR_HDRSZ offsetof(VersionedIntXor, data)
+/* Longest encoding of one entry, 4 + 64 time bits and 2 + 12 + 64 value bits */
+#define VERINT_XOR_MAX_ENTRY_BYTES 19
+
+/*
+ *
+ * Entry of backend local cache of detoasted versioned_ints, keyed by toast
+ * pointer. Toast values are never modified in place, so an entry stays
+ * valid across statements. Value ids are reused once OID counter wraps
+ * around, so cache is emptied at transaction end. value lives in its own
+ * memory context, so evicting it is a single context operation.
+ *
+ */
+typedef struct
+{
+    Oid toastrelid;
+    Oid valueid;
+} VerintCacheKey;
+
+/*
+ *
+ * ts_int query decoded by verint_ts_int_query, kept in fn_extra together
+ * with the composite it was decoded from.
+ *
+ */
+typedef struct
+{
+    Datum query;
+    VersionedIntEntry point;
+    uint32 len;
+    char *tuple;
+} VerintQueryCache;
+
+typedef struct
+{
+    VerintCacheKey key;
+    dlist_node lru;
+    MemoryContext context;
+    struct varlena *value;
+    Size size;
+} VerintCacheEntry;
+
 PG_FUNCTION_INFO_V1(versioned_int_in);
 PG_FUNCTION_INFO_V1(versioned_int_out);
 PG_FUNCTION_INFO_V1(versioned_int_typemod_in);
@@ -90,13 +529,85 @@ PG_FUNCTION_INFO_V1(make_versioned);
 PG_FUNCTION_INFO_V1(make_versioned_with_ts);
 PG_FUNCTION_INFO_V1(make_history);
 PG_FUNCTION_INFO_V1(get_history);
+PG_FUNCTION_INFO_V1(get_history_range);
+PG_FUNCTION_INFO_V1(versioned_int_slice);
+PG_FUNCTION_INFO_V1(versioned_int_since);
 PG_FUNCTION_INFO_V1(versioned_int_at_time);
+PG_FUNCTION_INFO_V1(versioned_int_at_times);
 PG_FUNCTION_INFO_V1(versioned_int_at_time_eq);
 PG_FUNCTION_INFO_V1(versioned_int_at_time_gt);
 PG_FUNCTION_INFO_V1(versioned_int_at_time_lt);
 PG_FUNCTION_INFO_V1(versioned_int_at_time_le);
 PG_FUNCTION_INFO_V1(versioned_int_at_time_ge);
+PG_FUNCTION_INFO_V1(verint_point_in);
+PG_FUNCTION_INFO_V1(verint_point_out);
+PG_FUNCTION_INFO_V1(verint_point_make);
+PG_FUNCTION_INFO_V1(versioned_int_at_point_eq);
+PG_FUNCTION_INFO_V1(versioned_int_at_point_lt);
+PG_FUNCTION_INFO_V1(versioned_int_at_point_gt);
+PG_FUNCTION_INFO_V1(versioned_int_at_point_le);
+PG_FUNCTION_INFO_V1(versioned_int_at_point_ge);
 PG_FUNCTION_INFO_V1(versioned_int_enforce_modifier);
+PG_FUNCTION_INFO_V1(versioned_int_twa);
+PG_FUNCTION_INFO_V1(versioned_int_integral);
+PG_FUNCTION_INFO_V1(versioned_int_min);
+PG_FUNCTION_INFO_V1(versioned_int_max);
+PG_FUNCTION_INFO_V1(versioned_int_first);
+PG_FUNCTION_INFO_V1(versioned_int_last);
+PG_FUNCTION_INFO_V1(versioned_int_percentile);
+PG_FUNCTION_INFO_V1(versioned_int_histogram);
+PG_FUNCTION_INFO_V1(versioned_int_increase);
+PG_FUNCTION_INFO_V1(versioned_int_rate);
+PG_FUNCTION_INFO_V1(versioned_int_irate);
+PG_FUNCTION_INFO_V1(versioned_int_first_when);
+PG_FUNCTION_INFO_V1(versioned_int_intervals_when);
+PG_FUNCTION_INFO_V1(versioned_int_times_of);
+PG_FUNCTION_INFO_V1(versioned_int_set_value_index);
+PG_FUNCTION_INFO_V1(versioned_int_resample);
+PG_FUNCTION_INFO_V1(versioned_int_lttb);
+PG_FUNCTION_INFO_V1(versioned_int_minmax_downsample);
+PG_FUNCTION_INFO_V1(versioned_int_compact);
+PG_FUNCTION_INFO_V1(versioned_int_tier_reset);
+PG_FUNCTION_INFO_V1(versioned_int_set_prefix);
+PG_FUNCTION_INFO_V1(versioned_int_set_split);
+PG_FUNCTION_INFO_V1(versioned_int_detoast_cache_stats);
+
+// Versioned row
+PG_FUNCTION_INFO_V1(versioned_row_in);
+PG_FUNCTION_INFO_V1(versioned_row_out);
+PG_FUNCTION_INFO_V1(make_versioned_row);
+PG_FUNCTION_INFO_V1(make_versioned_row_with_ts);
+PG_FUNCTION_INFO_V1(versioned_row_at_time);
+PG_FUNCTION_INFO_V1(versioned_row_populate);
+PG_FUNCTION_INFO_V1(versioned_row_column);
+
+// Versioned float8
+PG_FUNCTION_INFO_V1(versioned_float8_in);
+PG_FUNCTION_INFO_V1(versioned_float8_out);
+PG_FUNCTION_INFO_V1(versioned_float8_enforce_modifier);
+PG_FUNCTION_INFO_V1(make_versioned_float8);
+PG_FUNCTION_INFO_V1(make_versioned_float8_with_ts);
+PG_FUNCTION_INFO_V1(versioned_float8_at_time);
+PG_FUNCTION_INFO_V1(get_float8_history);
+PG_FUNCTION_INFO_V1(get_float8_history_range);
+PG_FUNCTION_INFO_V1(versioned_float8_twa);
+PG_FUNCTION_INFO_V1(versioned_float8_integral);
+PG_FUNCTION_INFO_V1(versioned_float8_min);
+PG_FUNCTION_INFO_V1(versioned_float8_max);
+PG_FUNCTION_INFO_V1(versioned_float8_first);
+PG_FUNCTION_INFO_V1(versioned_float8_last);
+PG_FUNCTION_INFO_V1(versioned_float8_at_time_eq);
+PG_FUNCTION_INFO_V1(versioned_float8_at_time_lt);
+PG_FUNCTION_INFO_V1(versioned_float8_at_time_gt);
+PG_FUNCTION_INFO_V1(versioned_float8_at_time_le);
+PG_FUNCTION_INFO_V1(versioned_float8_at_time_ge);
+PG_FUNCTION_INFO_V1(versioned_float8_eq_float8);
+PG_FUNCTION_INFO_V1(versioned_float8_neq_float8);
+PG_FUNCTION_INFO_V1(versioned_float8_gt_float8);
+PG_FUNCTION_INFO_V1(versioned_float8_ge_float8);
+PG_FUNCTION_INFO_V1(versioned_float8_lt_float8);
+PG_FUNCTION_INFO_V1(versioned_float8_le_float8);
+PG_FUNCTION_INFO_V1(versioned_float8_consistent);
 
 // Gist support
 PG_FUNCTION_INFO_V1(verint_rect_in);
@@ -110,25 +621,222 @@ PG_FUNCTION_INFO_V1(versioned_int_picksplit);
 
 // Btree
 PG_FUNCTION_INFO_V1(versioned_int_btree_cmp);
-static int versioned_int_cmp_internal(VersionedInt *a, VersionedInt *b);
+static int versioned_int_cmp_internal(int64 av, int64 bv);
+static int versioned_int_cmp_current(Datum a, Datum b);
 
 static VersionedInt *enforce_N_retention(VersionedInt *versionedInt, int32 maxCap);
 static VersionedInt *enforce_Time_retention(VersionedInt *versionedInt, int64 time);
+static VersionedInt *enforce_Byte_retention(VersionedInt *versionedInt, int32 budget);
+static Size verint_compressed_size(VersionedInt *versionedInt);
+static VersionedInt *enforce_Tier_retention(VersionedInt *versionedInt, VerintTierPolicy *policy);
+static int32 verint_tier_compact(VersionedInt *versionedInt, VerintTierPolicy *policy, TimestampTz now,
+                                 VersionedIntEntry *kept);
+static VerintTierPolicy *get_tier_policy(FunctionCallInfo fcinfo, int32 policy);
 static VersionedIntEntry *get_versioned_ints_value_at_time(VersionedInt *versionedInt, TimestampTz timestamp);
-static int32 first_time_greater_than_cutoff(VersionedIntEntry *entries, int32 count, TimestampTz cutoff);
-static int32 get_ts_insert_location(VersionedIntEntry *entries, int32 count, TimestampTz time);
+static int32 first_time_greater_than_cutoff(VersionedInt *versionedInt, TimestampTz cutoff);
+static int32 get_ts_insert_location(VersionedInt *versionedInt, TimestampTz time);
+static VersionedInt *verint_alloc(int32 cap, int32 count, int32 flags);
+static VersionedInt *verint_fetch_header(Datum datum);
+static VersionedInt *verint_detoast(Datum datum);
+static struct varlena *verint_detoast_cached(Datum datum);
+static void verint_cache_evict(Size budget);
+static void verint_cache_reset(void);
+static VersionedInt *verint_decode(VersionedIntDict *dict);
+static VersionedInt *verint_maybe_encode(VersionedInt *versionedInt);
+static int32 verint_split_tail_cap(Datum datum);
+static VersionedInt *verint_split(VersionedInt *versionedInt, int32 tailCap);
+static VersionedInt *verint_split_trim(VersionedIntSplit *split, int32 keep);
+static VersionedInt *verint_split_fit(VersionedIntSplit *split, int32 budget);
+static VersionedInt *verint_trim_encoded(Datum datum, int32 keep);
+static void verint_split_layout_error(void);
+static VersionedInt *verint_split_append(VersionedIntSplit *split, int64 value, TimestampTz time);
+static VersionedIntSplit *verint_split_assemble(int32 tailCap, int32 nblocks, int32 skip, const int32 *offsets,
+                                                const char *blocks, const VersionedIntEntry *tail, int32 ntail);
+static int32 verint_compress_block(const VersionedIntEntry *entries, int32 n, char *dst);
+static void verint_reader_read(VerintReader *reader, Size offset, Size size, void *dst);
+static void verint_reader_load_block(VerintReader *reader, int32 block);
+static void verint_copy_entries(VersionedIntEntry *dst, VersionedInt *src, int32 from, int32 n);
+static void verint_copy_prefix(int128 *dst, VersionedInt *src, int32 from, int32 n);
+static void verint_fill_prefix(VersionedInt *versionedInt, int32 from);
+static VersionedInt *verint_relayout(VersionedInt *versionedInt, int32 flags);
+static void verint_copy_value_index(int32 *dst, VersionedInt *src, int32 drop);
+static void verint_append_value_index(VersionedInt *versionedInt);
+static void verint_fill_value_index(VersionedInt *versionedInt);
+static int verint_value_index_cmp(const void *a, const void *b, void *arg);
+static void verint_reader_init(VerintReader *reader, Datum datum);
+static void verint_reader_fetch(VerintReader *reader, int32 from, int32 n, VersionedIntEntry *dst);
+static int32 verint_reader_search(VerintReader *reader, TimestampTz time, bool inclusive);
+static int128 verint_reader_prefix(VerintReader *reader, int32 i);
+static int128 verint_reader_integral_to(VerintReader *reader, TimestampTz time);
+static bool verint_fetch_last(Datum datum, VersionedIntEntry *entry);
+static bool verint_lookup_at(Datum datum, TimestampTz timestamp, VersionedIntEntry *entry);
+static Datum verint_point_op(FunctionCallInfo fcinfo, StrategyNumber strategy);
+static VersionedIntEntry *verint_ts_int_query(FunctionCallInfo fcinfo, Datum query, VerintValueType type);
+static bool verint_rect_consistent(const verint_rect *key, TimestampTz time_at, int64 value,
+                                   StrategyNumber strategy, bool leaf, bool *recheck);
+static VersionedInt *verint_extract(Datum datum, TimestampTz from, TimestampTz to);
+static VersionedInt *verint_zip(VersionedInt *a, VersionedInt *b, char op);
+static VersionedInt *verint_fetch_range_arg(FunctionCallInfo fcinfo, int32 minPoints);
+static Datum verint_points_result(FunctionCallInfo fcinfo, VersionedIntEntry *points, int32 n);
+static VerintSumState *verint_sum_state_new(MemoryContext context, int64 cap);
+static void verint_sum_reserve(VerintSumState *state, int64 n);
+static void verint_sum_compact(VerintSumState *state);
+static int verint_delta_cmp(const void *a, const void *b);
+static int verint_probe_cmp(const void *a, const void *b);
+static int verint_threshold_cmp(const void *a, const void *b);
+static bool get_range_stats(FunctionCallInfo fcinfo, VerintRangeStats *stats, bool integralOnly);
+static VerintStep *get_range_steps(FunctionCallInfo fcinfo, int32 *nsteps, int64 *total);
+static bool get_counter_stats(FunctionCallInfo fcinfo, VerintCounterStats *stats);
+static float8 extrapolated_increase(VerintCounterStats *stats);
+static VerintOp verint_parse_op(text *op);
+static MultirangeType *verint_intervals_matching(FunctionCallInfo fcinfo, VerintOp op, int64 value);
+static void verint_match_batch(const VersionedIntEntry *batch, int32 n, VerintOp op, int64 value, bool *matches);
+static inline void add_step(VerintStep *steps, int32 *nsteps, int64 *total, int64 value, TimestampTz start, TimestampTz end);
+static int verint_step_cmp(const void *a, const void *b);
+static bool get_range_bounds(FunctionCallInfo fcinfo, RangeType *range, TimestampTz *from, TimestampTz *to);
+static int64 floor_div(int64 a, int64 b);
+static pg_attribute_always_inline void accumulate_step(VerintRangeStats *stats, int64 value, TimestampTz start,
+                                                       TimestampTz end, VerintValueType type);
 static inline float8 get_area(const verint_rect *r);
 static inline float8 get_union_area(const verint_rect *r1, const verint_rect *r2);
 static inline void get_union_rect(const verint_rect *r1, const verint_rect *r2, verint_rect *dst);
 static VerintMinMax get_versioned_ints_min_max(VersionedInt *verint);
+static VersionedRow *verrow_alloc(int32 cap, int32 count, int32 ncols);
+static VersionedRow *verrow_insert(Datum datum, ArrayType *values, TimestampTz time);
+static int32 verrow_search(VersionedRow *row, TimestampTz time);
+static Datum verrow_tuple(VersionedRow *row, int32 i, TupleDesc tupdesc);
+static VersionedInt *verint_xor_encode(VersionedInt *versionedInt);
+static VersionedInt *verint_xor_decode(VersionedIntXor *xor);
+static VersionedInt *verint_xor_append(VersionedIntXor *xor, int64 value, TimestampTz time);
+static VersionedInt *verint_xor_trim(VersionedIntXor *xor, int32 keep);
+static void verint_xor_put(VersionedIntXor *xor, int64 value, TimestampTz time);
+static void verint_xor_next(const VersionedIntXor *xor, VerintXorState *state, int64 *pos, int32 i);
+static void verint_xor_put_bits(uint8 *buf, int64 *pos, uint64 bits, int n);
+static uint64 verint_xor_get_bits(const uint8 *buf, int64 *pos, int n);
+static pg_attribute_always_inline Datum enforce_modifier_internal(FunctionCallInfo fcinfo, VerintValueType type);
+static pg_attribute_always_inline Datum make_versioned_internal(FunctionCallInfo fcinfo, VerintValueType type);
+static pg_attribute_always_inline Datum make_versioned_with_ts_internal(FunctionCallInfo fcinfo,
+                                                                        VerintValueType type);
+static pg_attribute_always_inline Datum get_history_internal(FunctionCallInfo fcinfo, VerintValueType type);
+static pg_attribute_always_inline Datum get_history_range_internal(FunctionCallInfo fcinfo, VerintValueType type);
+static pg_attribute_always_inline bool get_range_stats_internal(FunctionCallInfo fcinfo, VerintRangeStats *stats,
+                                                                bool integralOnly, VerintValueType type);
+static bool get_float8_range_stats(FunctionCallInfo fcinfo, VerintRangeStats *stats, bool integralOnly);
+static pg_attribute_always_inline Datum versioned_int_consistent_internal(FunctionCallInfo fcinfo,
+                                                                          VerintValueType type);
+static Datum verint_at_time_op(FunctionCallInfo fcinfo, StrategyNumber strategy, VerintValueType type);
+static bool verint_compare(int64 a, int64 b, StrategyNumber strategy);
+
+static inline VersionedIntEntry *verint_entry(VersionedInt *versionedInt, int32 i)
+{
+    return &versionedInt->entries[i];
+}
+
+static inline int128 *verint_prefix(VersionedInt *versionedInt, int32 i)
+{
+    return &VERINT_PREFIX(versionedInt)[i];
+}
+
+static inline VersionedIntEntry *verint_last(VersionedInt *versionedInt)
+{
+    return verint_entry(versionedInt, versionedInt->count - 1);
+}
+
+/*
+ *
+ * Order preserving int64 key of a float8, under which versioned_float8's
+ * values are stored. Positive floats keep their bits, negative ones get
+ * all but sign bit flipped, so keys compare like floats. Like float8
+ * comparisons, -0 equals 0 and NaN equals NaN and is greater than any
+ * other value, so both are canonicalized first.
+ *
+ */
+static inline int64 verfloat_key(float8 value)
+{
+    int64 bits;
+
+    if (value == 0)
+        value = 0;
+    else if (isnan(value))
+        value = get_float8_nan();
+
+    memcpy(&bits, &value, sizeof(int64));
+    return bits >= 0 ? bits : bits ^ PG_INT64_MAX;
+}
+
+static inline float8 verfloat_value(int64 key)
+{
+    int64 bits = key >= 0 ? key : key ^ PG_INT64_MAX;
+    float8 value;
+
+    memcpy(&value, &bits, sizeof(float8));
+    return value;
+}
+
+static pg_attribute_always_inline int64 verint_datum_value(Datum datum, VerintValueType type)
+{
+    return type == VERINT_FLOAT8 ? verfloat_key(DatumGetFloat8(datum)) : DatumGetInt64(datum);
+}
+
+static pg_attribute_always_inline Datum verint_value_datum(int64 value, VerintValueType type)
+{
+    return type == VERINT_FLOAT8 ? Float8GetDatum(verfloat_value(value)) : Int64GetDatum(value);
+}
+
+static pg_attribute_always_inline const char *verint_type_name(VerintValueType type)
+{
+    return type == VERINT_FLOAT8 ? "versioned_float8" : "versioned_int";
+}
+
+/*
+ *
+ * Encodes freshly built history in the form stored for its type.
+ *
+ */
+static pg_attribute_always_inline VersionedInt *verint_encode(VersionedInt *versionedInt, VerintValueType type)
+{
+    return type == VERINT_FLOAT8 ? verint_xor_encode(versionedInt) : verint_maybe_encode(versionedInt);
+}
+
+static inline int64 verint_dict_value(VersionedIntDict *dict, int32 i)
+{
+    int32 perByte = 8 / dict->bits;
+    uint8 byte = VERINT_DICT_CODES(dict)[i / perByte];
+
+    return dict->data[(byte >> ((i % perByte) * dict->bits)) & ((1 << dict->bits) - 1)];
+}
 
 static TimestampTz get_first_write_ts();
 static TimestampTz first_write_ts = 0;
+static VerintTierPolicy *tier_policies = NULL;
 static void xact_callback(XactEvent event, void *arg);
 
+static int detoast_cache_size = 16384;
+static HTAB *detoast_cache = NULL;
+static MemoryContext detoast_cache_context = NULL;
+static dlist_head detoast_cache_lru;
+static Size detoast_cache_bytes = 0;
+static int64 detoast_cache_hits = 0;
+static int64 detoast_cache_misses = 0;
+
 void _PG_init(void)
 {
     RegisterXactCallback(xact_callback, NULL);
+
+    DefineCustomIntVariable("versioned_int.detoast_cache_size",
+                            "Sets the maximum memory used by backend to cache detoasted versioned_int values.",
+                            "Values larger than this are never cached. Zero disables the cache.",
+                            &detoast_cache_size,
+                            16384,
+                            0,
+                            MAX_KILOBYTES,
+                            PGC_USERSET,
+                            GUC_UNIT_KB,
+                            NULL,
+                            NULL,
+                            NULL);
+
+    MarkGUCPrefixReserved("versioned_int");
 }
 
 static void xact_callback(XactEvent event, void *arg)
@@ -137,6 +845,19 @@ static void xact_callback(XactEvent event, void *arg)
     {
         first_write_ts = 0;
     }
+
+    /*
+     * Tier policies live in TopTransactionContext, which is going away.
+     * Detoast cache is emptied, as toast value ids it's keyed by can be
+     * reused by the time next transaction reads them.
+     */
+    if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT ||
+        event == XACT_EVENT_PARALLEL_COMMIT || event == XACT_EVENT_PARALLEL_ABORT ||
+        event == XACT_EVENT_PREPARE)
+    {
+        tier_policies = NULL;
+        verint_cache_reset();
+    }
 }
 
 static TimestampTz get_first_write_ts()
@@ -200,10 +921,15 @@ Datum versioned_int_typemod_in(PG_FUNCTION_ARGS)
                  errmsg("char modifier must be exactly one character")));
     ch = cstr[0];
 
-    if (ch != 'N' && ch != 'D')
+    if (ch != 'N' && ch != 'D' && ch != 'T' && ch != 'B')
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("char modifier must be 'N', 'D', 'T' or 'B'")));
+
+    if (ch == 'B' && len < (int64)VERINT_SIZE(1, 0))
         ereport(ERROR,
                 (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("char modifier must be 'N' or 'D'")));
+                 errmsg("byte budget must be at least %d", (int)VERINT_SIZE(1, 0))));
 
     typmod = (int32)len | ((int32)ch << MODIFIER_CHARSHIFT);
     PG_RETURN_INT32(typmod);
@@ -241,18 +967,115 @@ Datum versioned_int_typemod_out(PG_FUNCTION_ARGS)
  */
 Datum versioned_int_enforce_modifier(PG_FUNCTION_ARGS)
 {
-    VersionedInt *src = (VersionedInt *)PG_DETOAST_DATUM_COPY(PG_GETARG_DATUM(0));
+    return enforce_modifier_internal(fcinfo, VERINT_INT8);
+}
+
+static pg_attribute_always_inline Datum enforce_modifier_internal(FunctionCallInfo fcinfo, VerintValueType type)
+{
+    Datum srcDatum = PG_GETARG_DATUM(0);
+    VersionedInt *src;
+    VersionedInt *result;
     int32 typmod = PG_GETARG_INT32(1);
     int32 len = typmod & LEN_MASK;
+    int32 tailCap;
     char ch = (typmod >> MODIFIER_CHARSHIFT) & 0xFF;
+    VerintReader reader;
+    VersionedIntEntry oldest;
+    VerintTierPolicy *policy;
+    TimestampTz cutoffTime;
 
     if (ch == 'N')
     {
-        src = enforce_N_retention(src, len);
+        /*
+         * Header alone tells whether value already conforms, so in the
+         * common case value is passed through without being detoasted.
+         */
+        src = verint_fetch_header(srcDatum);
+        if (src->cap == len ||
+            (src->cap < len && !(VERINT_FLAGS(src) & VERINT_FLAG_BOUNDED)))
+        {
+            PG_RETURN_DATUM(srcDatum);
+        }
+
+        /*
+         * Split and Gorilla encoded values are trimmed by skipping their
+         * oldest entries, nothing is decoded.
+         */
+        if (VERINT_FLAGS(src) & (VERINT_FLAG_SPLIT | VERINT_FLAG_XOR))
+        {
+            PG_RETURN_POINTER(verint_trim_encoded(srcDatum, len));
+        }
+
+        src = verint_detoast(srcDatum);
+        result = enforce_N_retention(src, len);
     }
     else if (ch == 'D')
     {
-        src = enforce_Time_retention(src, (int64)len * 24 * 60 * 60 * 1000000);
+        /*
+         * Split value is searched through a reader, which decodes only
+         * blocks the search touches, starting with oldest entry, and is
+         * then trimmed without decoding any. Gorilla encoded value is
+         * decoded by the reader, but not encoded again.
+         */
+        if (VERINT_FLAGS(verint_fetch_header(srcDatum)) & (VERINT_FLAG_SPLIT | VERINT_FLAG_XOR))
+        {
+            cutoffTime = GetCurrentTimestamp() - (int64)len * 24 * 60 * 60 * 1000000;
+            verint_reader_init(&reader, srcDatum);
+            if (reader.hdr->count == 0)
+                PG_RETURN_DATUM(srcDatum);
+
+            verint_reader_fetch(&reader, 0, 1, &oldest);
+            if (oldest.time > cutoffTime)
+                PG_RETURN_DATUM(srcDatum);
+
+            PG_RETURN_POINTER(verint_trim_encoded(srcDatum,
+                                                  reader.hdr->count - verint_reader_search(&reader, cutoffTime, true)));
+        }
+
+        src = verint_detoast(srcDatum);
+        result = enforce_Time_retention(src, (int64)len * 24 * 60 * 60 * 1000000);
+    }
+    else if (ch == 'B')
+    {
+        /*
+         * Sizes recorded in toast pointer or compressed header are enough
+         * to accept values that already fit, without decompressing them.
+         */
+        if (toast_raw_datum_size(srcDatum) <= (Size)len ||
+            (VARATT_IS_EXTENDED(DatumGetPointer(srcDatum)) &&
+             !VARATT_IS_SHORT(DatumGetPointer(srcDatum)) &&
+             toast_datum_size(srcDatum) <= (Size)len))
+        {
+            PG_RETURN_DATUM(srcDatum);
+        }
+
+        /* Split value sheds whole cold blocks, sized from its offsets array */
+        if (verint_split_tail_cap(srcDatum) > 0)
+        {
+            PG_RETURN_POINTER(verint_split_fit((VersionedIntSplit *)PG_DETOAST_DATUM(srcDatum), len));
+        }
+
+        src = verint_detoast(srcDatum);
+        result = enforce_Byte_retention(src, len);
+    }
+    else if (ch == 'T')
+    {
+        policy = get_tier_policy(fcinfo, len);
+
+        /* Split value whose oldest entry is younger than every tier is passed through undecoded */
+        if (verint_split_tail_cap(srcDatum) > 0)
+        {
+            verint_reader_init(&reader, srcDatum);
+            if (reader.hdr->count == 0)
+                PG_RETURN_DATUM(srcDatum);
+
+            verint_reader_fetch(&reader, 0, 1, &oldest);
+            if (oldest.time >= GetCurrentTimestamp() - policy->tiers[0].older_than)
+                PG_RETURN_DATUM(srcDatum);
+        }
+
+        src = verint_detoast(srcDatum);
+        result = enforce_Tier_retention(src, policy);
     }
     else
     {
@@ -261,78 +1084,254 @@ Datum versioned_int_enforce_modifier(PG_FUNCTION_ARGS)
                  errmsg("unknown retention policy character \"%c\"", ch)));
     }
 
-    PG_RETURN_POINTER(src);
+    if (result == src)
+    {
+        PG_RETURN_DATUM(srcDatum);
+    }
+
+    tailCap = verint_split_tail_cap(srcDatum);
+    if (tailCap > 0)
+    {
+        result = verint_split(result, tailCap);
+    }
+
+    PG_RETURN_POINTER(verint_encode(result, type));
 }
 
 /*
  *
- * make_versioned is a function that takes two arguments - versioned_int
- * and new value of that versioned int and adds new value to int's history.
- * is called like
- * make_versioned(null, new_value)
- * make_versioned(verint, new_value)
+ * Trims split or Gorilla encoded versioned_int to its newest keep entries
+ * while keeping its form.
  *
  */
-Datum make_versioned(PG_FUNCTION_ARGS)
+static VersionedInt *verint_trim_encoded(Datum datum, int32 keep)
 {
-    Size size;
-    VersionedInt *versionedInt = NULL;
-    VersionedInt *newVersionedInt = NULL;
-    int64 newValue;
-    TimestampTz time = get_first_write_ts();
-    if (!PG_ARGISNULL(0))
+    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(datum);
+
+    if (VERINT_FLAGS(versionedInt) & VERINT_FLAG_XOR)
+        return verint_xor_trim((VersionedIntXor *)versionedInt, keep);
+
+    return verint_split_trim((VersionedIntSplit *)versionedInt, keep);
+}
+
+/*
+ *
+ * versioned_int_compact applies tiered retention policy to a versioned_int.
+ * It does the same compaction 'T' typmod does on assignment, and is meant
+ * for periodic background passes over columns declared without one, like
+ * UPDATE t SET v = versioned_int_compact(v, 1)
+ *
+ */
+Datum versioned_int_compact(PG_FUNCTION_ARGS)
+{
+    Datum srcDatum = PG_GETARG_DATUM(0);
+    VersionedInt *src = verint_detoast(srcDatum);
+    VersionedInt *result = enforce_Tier_retention(src, get_tier_policy(fcinfo, PG_GETARG_INT32(1)));
+    int32 tailCap;
+
+    if (result == src)
+    {
+        PG_RETURN_DATUM(srcDatum);
+    }
+
+    tailCap = verint_split_tail_cap(srcDatum);
+    if (tailCap > 0)
+    {
+        result = verint_split(result, tailCap);
+    }
+
+    PG_RETURN_POINTER(verint_maybe_encode(result));
+}
+
+/*
+ *
+ * Statement trigger on versioned_int_tier. Policies are cached for the
+ * rest of the transaction once read, so this drops the cache and 'T'
+ * columns assigned later in the same transaction see the change. Other
+ * backends read policies afresh in their next transaction anyway.
+ *
+ */
+Datum versioned_int_tier_reset(PG_FUNCTION_ARGS)
+{
+    if (!CALLED_AS_TRIGGER(fcinfo))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+                 errmsg("versioned_int_tier_reset must be called as trigger")));
+    }
+
+    tier_policies = NULL;
+
+    PG_RETURN_POINTER(NULL);
+}
+
+/*
+ *
+ * versioned_int_set_prefix turns prefix integral array of a versioned_int
+ * on or off. With it on, integral and twa over any range cost two binary
+ * searches instead of a sweep of range, for 8 more bytes per entry.
+ * Array is kept up to date by every function that builds history, like
+ * UPDATE t SET v = versioned_int_set_prefix(v, true)
+ *
+ */
+Datum versioned_int_set_prefix(PG_FUNCTION_ARGS)
+{
+    Datum srcDatum = PG_GETARG_DATUM(0);
+    VersionedInt *src;
+    int32 flags;
+
+    if (PG_GETARG_BOOL(1) && verint_split_tail_cap(srcDatum) > 0)
+    {
+        verint_split_layout_error();
+    }
+
+    src = verint_detoast(srcDatum);
+    flags = VERINT_FLAGS(src) & ~VERINT_FLAG_PREFIX;
+    if (PG_GETARG_BOOL(1))
+    {
+        flags |= VERINT_FLAG_PREFIX;
+    }
+
+    if (flags == VERINT_FLAGS(src))
+    {
+        PG_RETURN_DATUM(srcDatum);
+    }
+
+    PG_RETURN_POINTER(verint_relayout(src, flags));
+}
+
+/*
+ *
+ * versioned_int_set_split(versioned_int, tail_size) stores versioned_int
+ * split into compressed cold blocks and a raw tail of up to tail_size
+ * newest entries, or plain again for tail_size 0. Split suits columns
+ * with EXTERNAL storage, whose appends and recent lookups then touch
+ * only the tail. Prefix and value index must be off, like
+ * ALTER TABLE t ALTER v SET STORAGE EXTERNAL;
+ * UPDATE t SET v = versioned_int_set_split(v, 1024)
+ *
+ */
+Datum versioned_int_set_split(PG_FUNCTION_ARGS)
+{
+    Datum srcDatum = PG_GETARG_DATUM(0);
+    int32 tailCap = PG_GETARG_INT32(1);
+    VersionedInt *src;
+
+    if (tailCap < 0 || tailCap > VERINT_MODIFIER_MAX_VALUE)
     {
-        versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                errmsg("tail size must be between 0 and %d", VERINT_MODIFIER_MAX_VALUE));
+    }
+
+    if (verint_split_tail_cap(srcDatum) == tailCap)
+    {
+        PG_RETURN_DATUM(srcDatum);
     }
+
+    src = verint_detoast(srcDatum);
+    if (tailCap == 0)
+    {
+        PG_RETURN_POINTER(src);
+    }
+
+    PG_RETURN_POINTER(verint_split(src, tailCap));
+}
+
+/*
+ *
+ * make_versioned is a function that takes two arguments - versioned_int
+ * and new value of that versioned int and adds new value to int's history.
+ * is called like
+ * make_versioned(null, new_value)
+ * make_versioned(verint, new_value)
+ *
+ */
+Datum make_versioned(PG_FUNCTION_ARGS)
+{
+    return make_versioned_internal(fcinfo, VERINT_INT8);
+}
+
+static pg_attribute_always_inline Datum make_versioned_internal(FunctionCallInfo fcinfo, VerintValueType type)
+{
+    Size size;
+    VersionedInt *versionedInt = NULL;
+    VersionedInt *newVersionedInt = NULL;
+    int32 newCap;
+    int64 newValue;
+    TimestampTz time = get_first_write_ts();
     if (PG_ARGISNULL(1))
     {
         ereport(ERROR,
                 (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED)),
-                errmsg("Cannot insert \"null\" as the value of versioned_int type"));
+                errmsg("Cannot insert \"null\" as the value of %s type", verint_type_name(type)));
+    }
+    newValue = verint_datum_value(PG_GETARG_DATUM(1), type);
+    if (!PG_ARGISNULL(0))
+    {
+        /*
+         * Split values take the append into their tail without decoding,
+         * Gorilla encoded ones continue their stream.
+         */
+        if (verint_split_tail_cap(PG_GETARG_DATUM(0)) > 0)
+        {
+            PG_RETURN_POINTER(verint_split_append((VersionedIntSplit *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0)),
+                                                  newValue, time));
+        }
+        if (VERINT_FLAGS(verint_fetch_header(PG_GETARG_DATUM(0))) & VERINT_FLAG_XOR)
+        {
+            PG_RETURN_POINTER(verint_xor_append((VersionedIntXor *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0)),
+                                                newValue, time));
+        }
+
+        versionedInt = verint_detoast(PG_GETARG_DATUM(0));
     }
-    newValue = PG_GETARG_INT64(1);
 
     if (versionedInt == NULL)
     {
-        versionedInt = (VersionedInt *)palloc0(sizeof(VersionedInt) + sizeof(VersionedIntEntry));
-        SET_VARSIZE(versionedInt, sizeof(VersionedInt) + sizeof(VersionedIntEntry));
-        versionedInt->cap = 1;
-        versionedInt->count = 1;
-        versionedInt->entries[0].value = newValue;
-        versionedInt->entries[0].time = time;
-        newVersionedInt = versionedInt;
+        newVersionedInt = verint_alloc(1, 1, 0);
+        newVersionedInt->entries[0].value = newValue;
+        newVersionedInt->entries[0].time = time;
     }
     else
     {
         if (versionedInt->count == versionedInt->cap)
         {
-            size = sizeof(VersionedInt) + 2 * versionedInt->cap * sizeof(VersionedIntEntry);
+            /*
+             * Full bounded value grows by one slot and loses the flag,
+             * 'N' enforcement of its column trims it back. Nothing is
+             * overwritten here, so a value that left its bounded column
+             * keeps its whole history.
+             */
+            newCap = (VERINT_FLAGS(versionedInt) & VERINT_FLAG_BOUNDED) ? versionedInt->cap + 1
+                                                                       : 2 * versionedInt->cap;
+            size = VERINT_SIZE((Size)newCap, VERINT_FLAGS(versionedInt));
             if (size >= (Size)MAX_VERSIONED_INT_SIZE)
             {
                 ereport(ERROR,
                         (errcode(ERRCODE_OUT_OF_MEMORY)),
                         errmsg("Extending column would push it pass the size of 512MB. Aborting"));
             }
-            newVersionedInt = (VersionedInt *)palloc0(size);
-            SET_VARSIZE(newVersionedInt, size);
-            newVersionedInt->cap = 2 * versionedInt->cap;
+            newVersionedInt = verint_alloc(newCap, versionedInt->count,
+                                           VERINT_FLAGS(versionedInt) & VERINT_LAYOUT_MASK);
         }
         else
         {
-            size = sizeof(VersionedInt) + versionedInt->cap * sizeof(VersionedIntEntry);
-            newVersionedInt = (VersionedInt *)palloc0(size);
-            SET_VARSIZE(newVersionedInt, size);
-            newVersionedInt->cap = versionedInt->cap;
+            newVersionedInt = verint_alloc(versionedInt->cap, versionedInt->count,
+                                           VERINT_FLAGS(versionedInt));
         }
 
-        newVersionedInt->count = versionedInt->count;
-        memcpy(newVersionedInt->entries, versionedInt->entries, versionedInt->count * sizeof(VersionedIntEntry));
+        verint_copy_entries(newVersionedInt->entries, versionedInt, 0, versionedInt->count);
+        verint_copy_prefix(VERINT_PREFIX(newVersionedInt), versionedInt, 0, versionedInt->count);
+        verint_copy_value_index(VERINT_VALUE_INDEX(newVersionedInt), versionedInt, 0);
         newVersionedInt->entries[newVersionedInt->count].value = newValue;
         newVersionedInt->entries[newVersionedInt->count].time = time;
         newVersionedInt->count += 1;
+        verint_fill_prefix(newVersionedInt, newVersionedInt->count - 1);
+        verint_append_value_index(newVersionedInt);
     }
 
-    PG_RETURN_POINTER(newVersionedInt);
+    PG_RETURN_POINTER(verint_encode(newVersionedInt, type));
 }
 
 /*
@@ -345,77 +1344,116 @@ Datum make_versioned(PG_FUNCTION_ARGS)
  *
  */
 Datum make_versioned_with_ts(PG_FUNCTION_ARGS)
+{
+    return make_versioned_with_ts_internal(fcinfo, VERINT_INT8);
+}
+
+static pg_attribute_always_inline Datum make_versioned_with_ts_internal(FunctionCallInfo fcinfo,
+                                                                        VerintValueType type)
 {
     Size size;
     VersionedInt *versionedInt = NULL;
     VersionedInt *newVersionedInt = NULL;
+    VersionedIntEntry last;
     int64 newValue;
     TimestampTz time;
-    int32 idx;
+    int32 idx, newCap;
+    int32 tailCap = 0;
 
-    if (!PG_ARGISNULL(0))
-    {
-        versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    }
     if (PG_ARGISNULL(1))
     {
         ereport(ERROR,
                 (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED)),
-                errmsg("Cannot insert \"null\" as the value of versioned_int type"));
+                errmsg("Cannot insert \"null\" as the value of %s type", verint_type_name(type)));
     }
     if (PG_ARGISNULL(2))
     {
         ereport(ERROR,
                 (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED)),
-                errmsg("Cannot insert \"null\" as the timestamp of versioned_int type"));
+                errmsg("Cannot insert \"null\" as the timestamp of %s type", verint_type_name(type)));
     }
 
-    newValue = PG_GETARG_INT64(1);
+    newValue = verint_datum_value(PG_GETARG_DATUM(1), type);
     time = PG_GETARG_TIMESTAMPTZ(2);
 
+    if (!PG_ARGISNULL(0))
+    {
+        /* Split and Gorilla encoded values take in order appends like make_versioned */
+        tailCap = verint_split_tail_cap(PG_GETARG_DATUM(0));
+        if (tailCap > 0 && verint_fetch_last(PG_GETARG_DATUM(0), &last) && last.time < time)
+        {
+            PG_RETURN_POINTER(verint_split_append((VersionedIntSplit *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0)),
+                                                  newValue, time));
+        }
+        if ((VERINT_FLAGS(verint_fetch_header(PG_GETARG_DATUM(0))) & VERINT_FLAG_XOR) &&
+            (!verint_fetch_last(PG_GETARG_DATUM(0), &last) || last.time < time))
+        {
+            PG_RETURN_POINTER(verint_xor_append((VersionedIntXor *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0)),
+                                                newValue, time));
+        }
+
+        versionedInt = verint_detoast(PG_GETARG_DATUM(0));
+    }
+
     if (versionedInt == NULL)
     {
-        versionedInt = (VersionedInt *)palloc0(sizeof(VersionedInt) + sizeof(VersionedIntEntry));
-        SET_VARSIZE(versionedInt, sizeof(VersionedInt) + sizeof(VersionedIntEntry));
-        versionedInt->cap = 1;
-        versionedInt->count = 1;
-        versionedInt->entries[0].value = newValue;
-        versionedInt->entries[0].time = time;
-        newVersionedInt = versionedInt;
+        newVersionedInt = verint_alloc(1, 1, 0);
+        newVersionedInt->entries[0].value = newValue;
+        newVersionedInt->entries[0].time = time;
     }
     else
     {
         if (versionedInt->count == versionedInt->cap)
         {
-            size = sizeof(VersionedInt) + 2 * versionedInt->cap * sizeof(VersionedIntEntry);
+            /*
+             * Full bounded value grows by one slot and loses the flag,
+             * 'N' enforcement of its column trims it back. Nothing is
+             * overwritten here, so a value that left its bounded column
+             * keeps its whole history.
+             */
+            newCap = (VERINT_FLAGS(versionedInt) & VERINT_FLAG_BOUNDED) ? versionedInt->cap + 1
+                                                                       : 2 * versionedInt->cap;
+            size = VERINT_SIZE((Size)newCap, VERINT_FLAGS(versionedInt));
             if (size >= (Size)MAX_VERSIONED_INT_SIZE)
             {
                 ereport(ERROR,
                         (errcode(ERRCODE_OUT_OF_MEMORY)),
                         errmsg("Extending column would push it pass the size of 512MB. Aborting"));
             }
-            newVersionedInt = (VersionedInt *)palloc0(size);
-            SET_VARSIZE(newVersionedInt, size);
-            newVersionedInt->cap = 2 * versionedInt->cap;
+            newVersionedInt = verint_alloc(newCap, versionedInt->count + 1,
+                                           VERINT_FLAGS(versionedInt) & VERINT_LAYOUT_MASK);
         }
         else
         {
-            size = sizeof(VersionedInt) + versionedInt->cap * sizeof(VersionedIntEntry);
-            newVersionedInt = (VersionedInt *)palloc0(size);
-            SET_VARSIZE(newVersionedInt, size);
-            newVersionedInt->cap = versionedInt->cap;
+            newVersionedInt = verint_alloc(versionedInt->cap, versionedInt->count + 1,
+                                           VERINT_FLAGS(versionedInt));
         }
 
-        newVersionedInt->count = versionedInt->count + 1;
-        idx = get_ts_insert_location(versionedInt->entries, versionedInt->count, time);
+        idx = get_ts_insert_location(versionedInt, time);
 
-        memcpy(newVersionedInt->entries, versionedInt->entries, idx * sizeof(VersionedIntEntry));
-        memcpy(&newVersionedInt->entries[idx + 1], &versionedInt->entries[idx], (versionedInt->count - idx) * sizeof(VersionedIntEntry));
+        verint_copy_entries(newVersionedInt->entries, versionedInt, 0, idx);
+        verint_copy_entries(&newVersionedInt->entries[idx + 1], versionedInt, idx, versionedInt->count - idx);
         newVersionedInt->entries[idx].value = newValue;
         newVersionedInt->entries[idx].time = time;
+        verint_copy_prefix(VERINT_PREFIX(newVersionedInt), versionedInt, 0, idx);
+        verint_fill_prefix(newVersionedInt, idx);
+        if (idx == versionedInt->count)
+        {
+            verint_copy_value_index(VERINT_VALUE_INDEX(newVersionedInt), versionedInt, 0);
+            verint_append_value_index(newVersionedInt);
+        }
+        else
+        {
+            verint_fill_value_index(newVersionedInt);
+        }
     }
 
-    PG_RETURN_POINTER(newVersionedInt);
+    if (tailCap > 0)
+    {
+        newVersionedInt = verint_split(newVersionedInt, tailCap);
+    }
+
+    PG_RETURN_POINTER(verint_encode(newVersionedInt, type));
 }
 
 /*
@@ -504,67 +1542,144 @@ Datum make_history(PG_FUNCTION_ARGS)
         newVersionedInt->entries[i].time = DatumGetTimestampTz(ts_datum);
     }
 
-    PG_RETURN_POINTER(newVersionedInt);
+    PG_RETURN_POINTER(verint_maybe_encode(newVersionedInt));
 }
 
 /*
  *
  * Function that returns versioned_int's history in format
- * timetsamptz, int64
+ * timetsamptz, int64. Value is detoasted once and whole result is
+ * materialized into tuplestore in a single pass.
  *
  */
 Datum get_history(PG_FUNCTION_ARGS)
 {
-    FuncCallContext *funcctx;
-    TupleDesc tupdesc;
-    HeapTuple heaptuple;
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int call_cntr;
-    int max_calls;
-    int64 idx;
-    NullsAndValues *state;
+    return get_history_internal(fcinfo, VERINT_INT8);
+}
+
+static pg_attribute_always_inline Datum get_history_internal(FunctionCallInfo fcinfo, VerintValueType type)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+    VersionedInt *versionedInt = verint_detoast(PG_GETARG_DATUM(0));
+    VersionedIntEntry *entry;
+    Datum values[2];
+    bool nulls[2] = {false, false};
+    int32 i;
+
+    InitMaterializedSRF(fcinfo, 0);
 
-    if (SRF_IS_FIRSTCALL())
+    for (i = 0; i < versionedInt->count; i++)
     {
-        MemoryContext oldContext;
+        entry = verint_entry(versionedInt, i);
+        values[0] = TimestampTzGetDatum(entry->time);
+        values[1] = verint_value_datum(entry->value, type);
 
-        funcctx = SRF_FIRSTCALL_INIT();
-        oldContext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
-        funcctx->max_calls = versionedInt->count;
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
 
-        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
-        {
-            ereport(ERROR,
-                    (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-                     errmsg("function returning composite called in a context that does not accept one")));
-        }
-        funcctx->tuple_desc = BlessTupleDesc(tupdesc);
+    return (Datum)0;
+}
+
+/*
+ *
+ * get_history(versioned_int, tstzrange) returns only part of history
+ * that overlaps with given range, including the entry that was in
+ * effect at range's start. Bounds are found by binary search, and
+ * values stored externally without compression are read through slices
+ * in fixed size batches, so memory use doesn't grow with history's length.
+ *
+ */
+Datum get_history_range(PG_FUNCTION_ARGS)
+{
+    return get_history_range_internal(fcinfo, VERINT_INT8);
+}
+
+static pg_attribute_always_inline Datum get_history_range_internal(FunctionCallInfo fcinfo, VerintValueType type)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+    RangeType *range = PG_GETARG_RANGE_P(1);
+    VerintReader reader;
+    VersionedIntEntry *batch;
+    TimestampTz from, to;
+    Datum values[2];
+    bool nulls[2] = {false, false};
+    int32 first, end, n, i;
 
-        state = (NullsAndValues *)palloc(sizeof(NullsAndValues));
-        funcctx->user_fctx = (void *)state;
+    InitMaterializedSRF(fcinfo, 0);
 
-        MemoryContextSwitchTo(oldContext);
-    }
+    if (!get_range_bounds(fcinfo, range, &from, &to))
+        return (Datum)0;
 
-    funcctx = SRF_PERCALL_SETUP();
-    call_cntr = funcctx->call_cntr;
-    max_calls = funcctx->max_calls;
-    tupdesc = funcctx->tuple_desc;
-    idx = call_cntr;
-    state = (NullsAndValues *)funcctx->user_fctx;
+    verint_reader_init(&reader, PG_GETARG_DATUM(0));
 
-    if (call_cntr >= max_calls)
+    first = Max(verint_reader_search(&reader, from, true) - 1, 0);
+    end = verint_reader_search(&reader, to, false);
+
+    batch = (VersionedIntEntry *)palloc(Min(Max(end - first, 1), VERINT_READER_BATCH) * sizeof(VersionedIntEntry));
+    while (first < end)
     {
-        SRF_RETURN_DONE(funcctx);
+        n = Min(end - first, VERINT_READER_BATCH);
+        verint_reader_fetch(&reader, first, n, batch);
+
+        for (i = 0; i < n; i++)
+        {
+            values[0] = TimestampTzGetDatum(batch[i].time);
+            values[1] = verint_value_datum(batch[i].value, type);
+
+            tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+        }
+
+        first += n;
     }
 
-    state->nulls[0] = false;
-    state->nulls[1] = false;
-    state->values[0] = TimestampTzGetDatum(versionedInt->entries[idx].time);
-    state->values[1] = Int64GetDatum(versionedInt->entries[idx].value);
+    return (Datum)0;
+}
+
+/*
+ *
+ * versioned_int_slice(versioned_int, tstzrange) returns versioned_int
+ * made of entries whose time lies in given range, or null if there are
+ * none. Unlike get_history(versioned_int, tstzrange), entry in effect at
+ * range's start is not included, so slices of adjacent ranges never
+ * overlap.
+ *
+ */
+Datum versioned_int_slice(PG_FUNCTION_ARGS)
+{
+    VersionedInt *result;
+    TimestampTz from, to;
+
+    if (!get_range_bounds(fcinfo, PG_GETARG_RANGE_P(1), &from, &to))
+        PG_RETURN_NULL();
+
+    result = verint_extract(PG_GETARG_DATUM(0), from, to);
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_POINTER(result);
+}
+
+/*
+ *
+ * versioned_int_since(versioned_int, timestamptz) returns versioned_int
+ * made of entries written strictly after given watermark, or null if
+ * there are none. Meant for incremental sync, like
+ * SELECT versioned_int_since(v, last_synced_at) FROM t
+ *
+ */
+Datum versioned_int_since(PG_FUNCTION_ARGS)
+{
+    TimestampTz watermark = PG_GETARG_TIMESTAMPTZ(1);
+    VersionedInt *result;
 
-    heaptuple = heap_form_tuple(tupdesc, state->values, state->nulls);
-    SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(heaptuple));
+    if (watermark == DT_NOEND)
+        PG_RETURN_NULL();
+
+    result = verint_extract(PG_GETARG_DATUM(0), watermark + 1, DT_NOEND);
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_POINTER(result);
 }
 
 /*
@@ -575,1175 +1690,5263 @@ Datum get_history(PG_FUNCTION_ARGS)
  */
 Datum versioned_int_at_time(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
     TimestampTz time_at = PG_GETARG_TIMESTAMPTZ(1);
+    VersionedIntEntry entry;
 
-    VersionedIntEntry *entry = get_versioned_ints_value_at_time(versionedInt, time_at);
-    if (entry == NULL)
+    if (!verint_lookup_at(PG_GETARG_DATUM(0), time_at, &entry))
     {
         PG_RETURN_NULL();
     }
 
-    PG_RETURN_INT64(entry->value);
+    PG_RETURN_INT64(entry.value);
 }
 
 /*
  *
- * Function that is used for comparing versioned_int with composite (timestamp, value).
- * In sql that would look like versioned_int @= (timestamp, value).
+ * Batch point in time lookup, i.e. versioned_int @ timestamptz[].
+ * History is read once and probe times are sorted, so all of them are
+ * answered with a single merge of probes and entries. Result array has
+ * input's shape, with nulls for null probes and for times before
+ * versioned_int existed.
  *
  */
-Datum versioned_int_at_time_eq(PG_FUNCTION_ARGS)
+Datum versioned_int_at_times(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    HeapTupleHeader t = PG_GETARG_HEAPTUPLEHEADER(1);
-    bool isNull;
-    Datum timestampDatum, valueDatum;
-    int64 value;
-    TimestampTz timestamp;
-    VersionedIntEntry *entry;
-
-    timestampDatum = GetAttributeByName(t, "ts", &isNull);
-    if (isNull)
+    ArrayType *times = PG_GETARG_ARRAYTYPE_P(1);
+    ArrayType *result;
+    VerintReader reader;
+    VersionedIntEntry *entries;
+    VerintProbe *probes;
+    Datum *time_datums;
+    bool *time_nulls;
+    Datum *values;
+    bool *nulls;
+    int n_times, n_probes, i, j;
+    int32 first, end;
+
+    deconstruct_array(times, TIMESTAMPTZOID, sizeof(TimestampTz), FLOAT8PASSBYVAL, TYPALIGN_DOUBLE,
+                      &time_datums, &time_nulls, &n_times);
+
+    if (n_times == 0)
     {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("ts cannot be null")));
+        PG_RETURN_ARRAYTYPE_P(construct_empty_array(INT8OID));
     }
 
-    valueDatum = GetAttributeByName(t, "value", &isNull);
-    if (isNull)
+    values = (Datum *)palloc0(n_times * sizeof(Datum));
+    nulls = (bool *)palloc(n_times * sizeof(bool));
+    probes = (VerintProbe *)palloc(n_times * sizeof(VerintProbe));
+
+    n_probes = 0;
+    for (i = 0; i < n_times; i++)
     {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("value cannot be null")));
+        nulls[i] = true;
+        if (!time_nulls[i])
+        {
+            probes[n_probes].time = DatumGetTimestampTz(time_datums[i]);
+            probes[n_probes].idx = i;
+            n_probes++;
+        }
     }
+    qsort(probes, n_probes, sizeof(VerintProbe), verint_probe_cmp);
 
-    value = DatumGetInt64(valueDatum);
-    timestamp = DatumGetTimestampTz(timestampDatum);
-
-    entry = get_versioned_ints_value_at_time(versionedInt, timestamp);
-    if (entry == NULL)
+    if (n_probes > 0)
     {
-        PG_RETURN_NULL();
+        /* Only entries in effect somewhere between first and last probe are read */
+        verint_reader_init(&reader, PG_GETARG_DATUM(0));
+        first = Max(verint_reader_search(&reader, probes[0].time, true) - 1, 0);
+        end = verint_reader_search(&reader, probes[n_probes - 1].time, true);
+
+        entries = (VersionedIntEntry *)palloc(Max(end - first, 1) * sizeof(VersionedIntEntry));
+        verint_reader_fetch(&reader, first, end - first, entries);
+
+        j = -1;
+        for (i = 0; i < n_probes; i++)
+        {
+            while (j + 1 < end - first && entries[j + 1].time <= probes[i].time)
+                j++;
+
+            if (j >= 0)
+            {
+                values[probes[i].idx] = Int64GetDatum(entries[j].value);
+                nulls[probes[i].idx] = false;
+            }
+        }
     }
 
-    PG_RETURN_BOOL(entry->value == value);
+    result = construct_md_array(values, nulls, ARR_NDIM(times), ARR_DIMS(times), ARR_LBOUND(times),
+                                INT8OID, sizeof(int64), FLOAT8PASSBYVAL, TYPALIGN_DOUBLE);
+
+    PG_RETURN_ARRAYTYPE_P(result);
 }
 
-Datum versioned_int_at_time_lt(PG_FUNCTION_ARGS)
+/*
+ *
+ * Time weighted aggregates over tstzrange, treating versioned_int as a
+ * step function in which each value holds until next entry. Unbounded
+ * range end stands for current transaction's timestamp. All of them
+ * return null if versioned_int didn't exist anywhere in range.
+ *
+ */
+Datum versioned_int_twa(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    HeapTupleHeader t = PG_GETARG_HEAPTUPLEHEADER(1);
-    bool isNull;
-    Datum timestampDatum, valueDatum;
-    int64 value;
-    TimestampTz timestamp;
-    VersionedIntEntry *entry;
+    VerintRangeStats stats;
 
-    timestampDatum = GetAttributeByName(t, "ts", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("ts cannot be null")));
-    }
+    if (!get_range_stats(fcinfo, &stats, true))
+        PG_RETURN_NULL();
 
-    valueDatum = GetAttributeByName(t, "value", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("value cannot be null")));
-    }
+    PG_RETURN_FLOAT8((float8)stats.integral / (float8)stats.covered);
+}
 
-    value = DatumGetInt64(valueDatum);
-    timestamp = DatumGetTimestampTz(timestampDatum);
+Datum versioned_int_integral(PG_FUNCTION_ARGS)
+{
+    VerintRangeStats stats;
 
-    entry = get_versioned_ints_value_at_time(versionedInt, timestamp);
-    if (entry == NULL)
+    if (!get_range_stats(fcinfo, &stats, true))
         PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(entry->value < value);
+    PG_RETURN_FLOAT8((float8)stats.integral / USECS_PER_SEC);
 }
 
-Datum versioned_int_at_time_gt(PG_FUNCTION_ARGS)
+Datum versioned_int_min(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    HeapTupleHeader t = PG_GETARG_HEAPTUPLEHEADER(1);
-    bool isNull;
-    Datum timestampDatum, valueDatum;
-    int64 value;
-    TimestampTz timestamp;
-    VersionedIntEntry *entry;
+    VerintRangeStats stats;
 
-    timestampDatum = GetAttributeByName(t, "ts", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("ts cannot be null")));
-    }
+    if (!get_range_stats(fcinfo, &stats, false))
+        PG_RETURN_NULL();
 
-    valueDatum = GetAttributeByName(t, "value", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("value cannot be null")));
-    }
+    PG_RETURN_INT64(stats.min);
+}
 
-    value = DatumGetInt64(valueDatum);
-    timestamp = DatumGetTimestampTz(timestampDatum);
+Datum versioned_int_max(PG_FUNCTION_ARGS)
+{
+    VerintRangeStats stats;
 
-    entry = get_versioned_ints_value_at_time(versionedInt, timestamp);
-    if (entry == NULL)
+    if (!get_range_stats(fcinfo, &stats, false))
         PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(entry->value > value);
+    PG_RETURN_INT64(stats.max);
 }
 
-Datum versioned_int_at_time_le(PG_FUNCTION_ARGS)
+Datum versioned_int_first(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    HeapTupleHeader t = PG_GETARG_HEAPTUPLEHEADER(1);
-    bool isNull;
-    Datum timestampDatum, valueDatum;
-    int64 value;
-    TimestampTz timestamp;
-    VersionedIntEntry *entry;
-
-    timestampDatum = GetAttributeByName(t, "ts", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("ts cannot be null")));
-    }
-
-    valueDatum = GetAttributeByName(t, "value", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("value cannot be null")));
-    }
-
-    value = DatumGetInt64(valueDatum);
-    timestamp = DatumGetTimestampTz(timestampDatum);
+    VerintRangeStats stats;
 
-    entry = get_versioned_ints_value_at_time(versionedInt, timestamp);
-    if (entry == NULL)
+    if (!get_range_stats(fcinfo, &stats, false))
         PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(entry->value <= value);
+    PG_RETURN_INT64(stats.first);
 }
 
-Datum versioned_int_at_time_ge(PG_FUNCTION_ARGS)
+Datum versioned_int_last(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    HeapTupleHeader t = PG_GETARG_HEAPTUPLEHEADER(1);
-    bool isNull;
-    Datum timestampDatum, valueDatum;
-    int64 value;
-    TimestampTz timestamp;
-    VersionedIntEntry *entry;
-
-    timestampDatum = GetAttributeByName(t, "ts", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("ts cannot be null")));
-    }
-
-    valueDatum = GetAttributeByName(t, "value", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("value cannot be null")));
-    }
-
-    value = DatumGetInt64(valueDatum);
-    timestamp = DatumGetTimestampTz(timestampDatum);
+    VerintRangeStats stats;
 
-    entry = get_versioned_ints_value_at_time(versionedInt, timestamp);
-    if (entry == NULL)
+    if (!get_range_stats(fcinfo, &stats, false))
         PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(entry->value >= value);
+    PG_RETURN_INT64(stats.last);
 }
 
 /*
  *
- * Output function for versioned_int, i.e. function that turns
- * type's internal representation to string. Here we just get
- * versioned_int's current value.
+ * versioned_int_percentile(v, tstzrange, float8[]) returns, for each
+ * fraction p, smallest value that versioned_int held for at least p of
+ * the time it existed within range. Steps are collected and sorted by
+ * value once, and all fractions are answered in one cumulative walk.
+ * Result array has shape of fractions array, with nulls for null ones.
  *
  */
-Datum versioned_int_out(PG_FUNCTION_ARGS)
+Datum versioned_int_percentile(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    char *result;
-
-    if (versionedInt->count == 0)
-    {
-        result = psprintf("NULL");
-    }
-    else
+    ArrayType *fractions = PG_GETARG_ARRAYTYPE_P(2);
+    VerintStep *steps;
+    VerintThreshold *thresholds;
+    Datum *fraction_datums;
+    bool *fraction_nulls;
+    Datum *values;
+    bool *nulls;
+    float8 fraction;
+    int64 total, cumulative;
+    int32 nsteps, nfractions, nthresholds, i, j;
+
+    deconstruct_array(fractions, FLOAT8OID, sizeof(float8), FLOAT8PASSBYVAL, TYPALIGN_DOUBLE,
+                      &fraction_datums, &fraction_nulls, &nfractions);
+
+    values = (Datum *)palloc0((nfractions + 1) * sizeof(Datum));
+    nulls = (bool *)palloc((nfractions + 1) * sizeof(bool));
+    thresholds = (VerintThreshold *)palloc((nfractions + 1) * sizeof(VerintThreshold));
+
+    steps = get_range_steps(fcinfo, &nsteps, &total);
+    nthresholds = 0;
+    for (i = 0; i < nfractions; i++)
     {
-        result = psprintf("%ld", versionedInt->entries[versionedInt->count - 1].value);
+        nulls[i] = true;
+        if (fraction_nulls[i])
+            continue;
+
+        fraction = DatumGetFloat8(fraction_datums[i]);
+        if (fraction < 0 || fraction > 1 || isnan(fraction))
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                    errmsg("percentile value %g is not between 0 and 1", fraction));
+        }
+
+        thresholds[nthresholds].weight = (int64)ceil(fraction * total);
+        thresholds[nthresholds].idx = i;
+        nthresholds++;
     }
-    PG_RETURN_CSTRING(result);
-}
 
-/*
- *
- * GIST INDEX METHOD SUPPORT FOR VERSIONED_INT
- *
- */
-Datum verint_rect_in(PG_FUNCTION_ARGS)
-{
-    ereport(ERROR,
-            (errcode(ERRCODE_FEATURE_NOT_SUPPORTED)),
-            errmsg("Conversion between text representation and verint_rect is not possible"));
-}
+    if (steps == NULL)
+        PG_RETURN_NULL();
 
-Datum verint_rect_out(PG_FUNCTION_ARGS)
-{
-    verint_rect *rect = (verint_rect *)PG_GETARG_POINTER(0);
+    qsort(steps, nsteps, sizeof(VerintStep), verint_step_cmp);
+    qsort(thresholds, nthresholds, sizeof(VerintThreshold), verint_threshold_cmp);
 
-    char *result = psprintf("%ld,%ld,%ld,%ld",
-                            rect->lower_tzbound,
-                            rect->upper_tzbound,
-                            rect->lower_val,
-                            rect->upper_val);
+    cumulative = steps[0].duration;
+    j = 0;
+    for (i = 0; i < nthresholds; i++)
+    {
+        while (j + 1 < nsteps && cumulative < thresholds[i].weight)
+        {
+            j++;
+            cumulative += steps[j].duration;
+        }
 
-    PG_RETURN_CSTRING(result);
+        values[thresholds[i].idx] = Int64GetDatum(steps[j].value);
+        nulls[thresholds[i].idx] = false;
+    }
+
+    PG_RETURN_ARRAYTYPE_P(construct_md_array(values, nulls, ARR_NDIM(fractions), ARR_DIMS(fractions),
+                                             ARR_LBOUND(fractions), INT8OID, sizeof(int64),
+                                             FLOAT8PASSBYVAL, TYPALIGN_DOUBLE));
 }
 
 /*
  *
- * versioned_int's gist consistency function
+ * versioned_int_histogram(v, tstzrange, bigint[]) returns seconds that
+ * versioned_int spent within range in each bucket delimited by given
+ * ascending bounds. n bounds make n + 1 buckets, first one holding values
+ * below bounds[1] and last one values at or above bounds[n].
  *
  */
-Datum versioned_int_consistent(PG_FUNCTION_ARGS)
+Datum versioned_int_histogram(PG_FUNCTION_ARGS)
 {
-    bool isNull;
-    Datum valueDatum, time_at_datum;
-    int64 value;
-    TimestampTz time_at;
-    GISTENTRY *entry = (GISTENTRY *)PG_GETARG_POINTER(0);
-    Datum query_datum = PG_GETARG_DATUM(1);
-    StrategyNumber strategy = (StrategyNumber)PG_GETARG_UINT16(2);
-    bool *recheck = (bool *)PG_GETARG_POINTER(4);
-    verint_rect *key = (verint_rect *)DatumGetPointer(entry->key);
-
-    HeapTupleHeader t = DatumGetHeapTupleHeader(query_datum);
-
-    time_at_datum = GetAttributeByName(t, "ts", &isNull);
-    if (isNull)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("ts cannot be null")));
-    }
-
-    valueDatum = GetAttributeByName(t, "value", &isNull);
-    if (isNull)
+    ArrayType *boundsArray = PG_GETARG_ARRAYTYPE_P(2);
+    VerintStep *steps;
+    Datum *bound_datums;
+    bool *bound_nulls;
+    int64 *bounds;
+    float8 *seconds;
+    Datum *values;
+    int32 nsteps, nbounds, i, l, r;
+    int64 total;
+
+    if (array_contains_nulls(boundsArray))
     {
         ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("value cannot be null")));
+                (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED)),
+                errmsg("histogram bounds must not contain nulls"));
     }
 
-    value = DatumGetInt64(valueDatum);
-    time_at = DatumGetTimestampTz(time_at_datum);
-
-    if (time_at < key->lower_tzbound || time_at > key->upper_tzbound)
-    {
-        *recheck = false;
-        PG_RETURN_BOOL(false);
-    }
+    deconstruct_array(boundsArray, INT8OID, sizeof(int64), FLOAT8PASSBYVAL, TYPALIGN_DOUBLE,
+                      &bound_datums, &bound_nulls, &nbounds);
 
-    switch (strategy)
+    bounds = (int64 *)palloc((nbounds + 1) * sizeof(int64));
+    for (i = 0; i < nbounds; i++)
     {
-    case 1: // @=
-        if (key->lower_val <= value && value <= key->upper_val)
+        bounds[i] = DatumGetInt64(bound_datums[i]);
+        if (i > 0 && bounds[i] <= bounds[i - 1])
         {
-            *recheck = GIST_LEAF(entry);
-            PG_RETURN_BOOL(true);
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                    errmsg("histogram bounds must be strictly ascending"));
         }
-        break;
+    }
 
-    case 2: // @<
-        if (key->lower_val < value)
-        {
-            *recheck = GIST_LEAF(entry);
-            PG_RETURN_BOOL(true);
-        }
-        break;
+    steps = get_range_steps(fcinfo, &nsteps, &total);
+    if (steps == NULL)
+        PG_RETURN_NULL();
 
-    case 3: // @>
-        if (key->upper_val > value)
+    seconds = (float8 *)palloc0((nbounds + 1) * sizeof(float8));
+    for (i = 0; i < nsteps; i++)
+    {
+        /* Number of bounds not above value is index of its bucket */
+        l = 0;
+        r = nbounds;
+        while (l < r)
         {
-            *recheck = GIST_LEAF(entry);
-            PG_RETURN_BOOL(true);
-        }
-        break;
+            int32 mid = l + (r - l) / 2;
 
-    case 4: // @<=
-        if (key->lower_val <= value)
-        {
-            *recheck = GIST_LEAF(entry);
-            PG_RETURN_BOOL(true);
+            if (bounds[mid] <= steps[i].value)
+                l = mid + 1;
+            else
+                r = mid;
         }
-        break;
 
-    case 5: // @>=
-        if (key->upper_val >= value)
-        {
-            *recheck = GIST_LEAF(entry);
-            PG_RETURN_BOOL(true);
-        }
-        break;
+        seconds[l] += (float8)steps[i].duration / USECS_PER_SEC;
+    }
 
-    default:
-        ereport(ERROR,
-                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-                 errmsg("gist index access method strategy not supported")));
+    values = (Datum *)palloc((nbounds + 1) * sizeof(Datum));
+    for (i = 0; i <= nbounds; i++)
+    {
+        values[i] = Float8GetDatum(seconds[i]);
     }
 
-    *recheck = false;
-    PG_RETURN_BOOL(false);
+    PG_RETURN_ARRAYTYPE_P(construct_array(values, nbounds + 1, FLOAT8OID, sizeof(float8),
+                                          FLOAT8PASSBYVAL, TYPALIGN_DOUBLE));
 }
 
 /*
  *
- * versioned_int's gist union function
+ * Counter functions over tstzrange, in the manner of Prometheus. They
+ * treat versioned_int as monotonic counter whose drops mean a reset to
+ * zero, and look only at entries written within range. increase and rate
+ * extrapolate to range's edges and need two entries in range, irate uses
+ * last two of them. Unbounded range end stands for current transaction's
+ * timestamp, unbounded start for time of first entry in range.
  *
  */
-Datum versioned_int_union(PG_FUNCTION_ARGS)
+Datum versioned_int_increase(PG_FUNCTION_ARGS)
 {
-    int i;
-    verint_rect *nodeentry;
-    GistEntryVector *entryvec = (GistEntryVector *)PG_GETARG_POINTER(0);
-    GISTENTRY *ent = entryvec->vector;
-    int n = entryvec->n;
-    verint_rect *ret = (verint_rect *)palloc0(sizeof(verint_rect));
+    VerintCounterStats stats;
 
-    ret->lower_tzbound = PG_INT64_MAX;
-    ret->upper_tzbound = PG_INT64_MIN;
-    ret->lower_val = PG_INT64_MAX;
-    ret->upper_val = PG_INT64_MIN;
+    if (!get_counter_stats(fcinfo, &stats) || stats.count < 2)
+        PG_RETURN_NULL();
 
-    for (i = 0; i < n; i++)
-    {
-        nodeentry = (verint_rect *)DatumGetPointer(ent[i].key);
-        ret->lower_tzbound = Min(ret->lower_tzbound, nodeentry->lower_tzbound);
-        ret->upper_tzbound = Max(ret->upper_tzbound, nodeentry->upper_tzbound);
-        ret->lower_val = Min(ret->lower_val, nodeentry->lower_val);
-        ret->upper_val = Max(ret->upper_val, nodeentry->upper_val);
-    }
+    PG_RETURN_FLOAT8(extrapolated_increase(&stats));
+}
 
-    PG_RETURN_POINTER(ret);
+Datum versioned_int_rate(PG_FUNCTION_ARGS)
+{
+    VerintCounterStats stats;
+
+    if (!get_counter_stats(fcinfo, &stats) || stats.count < 2)
+        PG_RETURN_NULL();
+
+    PG_RETURN_FLOAT8(extrapolated_increase(&stats) / ((float8)(stats.to - stats.from) / USECS_PER_SEC));
+}
+
+Datum versioned_int_irate(PG_FUNCTION_ARGS)
+{
+    VerintCounterStats stats;
+    int64 delta;
+
+    if (!get_counter_stats(fcinfo, &stats) || stats.count < 2 || stats.last.time == stats.prev.time)
+        PG_RETURN_NULL();
+
+    delta = stats.last.value < stats.prev.value ? stats.last.value : stats.last.value - stats.prev.value;
+
+    PG_RETURN_FLOAT8((float8)delta / ((float8)(stats.last.time - stats.prev.time) / USECS_PER_SEC));
 }
 
 /*
  *
- * versioned_int's gist compress function
+ * versioned_int_first_when(v, op, value, after) returns earliest time
+ * not before after at which "v op value" held, or null if it never did.
+ * That is after itself if value in effect then matches. Search starts at
+ * entry in effect at after, found by binary search, and stops at first
+ * match.
  *
  */
-Datum versioned_int_compress(PG_FUNCTION_ARGS)
+Datum versioned_int_first_when(PG_FUNCTION_ARGS)
 {
-    GISTENTRY *retval;
-    verint_rect *rect;
-    VersionedInt *verint;
-    GISTENTRY *entry = (GISTENTRY *)PG_GETARG_POINTER(0);
-    VerintMinMax minmax;
+    VerintOp op = verint_parse_op(PG_GETARG_TEXT_PP(1));
+    int64 value = PG_GETARG_INT64(2);
+    TimestampTz after = PG_GETARG_TIMESTAMPTZ(3);
+    VerintReader reader;
+    VersionedIntEntry *batch;
+    bool *matches;
+    int32 first, end, n, i;
+
+    verint_reader_init(&reader, PG_GETARG_DATUM(0));
+    first = Max(verint_reader_search(&reader, after, true) - 1, 0);
+    end = reader.hdr->count;
+    if (first >= end)
+        PG_RETURN_NULL();
 
-    if (entry->leafkey)
+    batch = (VersionedIntEntry *)palloc(Min(end - first, VERINT_READER_BATCH) * sizeof(VersionedIntEntry));
+    matches = (bool *)palloc(Min(end - first, VERINT_READER_BATCH) * sizeof(bool));
+    while (first < end)
     {
-        rect = (verint_rect *)palloc(sizeof(verint_rect));
-        verint = (VersionedInt *)PG_DETOAST_DATUM(entry->key);
+        n = Min(end - first, VERINT_READER_BATCH);
+        verint_reader_fetch(&reader, first, n, batch);
+        verint_match_batch(batch, n, op, value, matches);
 
-        rect->lower_tzbound = verint->entries[0].time;
-        rect->upper_tzbound = PG_INT64_MAX - 1;
-        minmax = get_versioned_ints_min_max(verint);
-        rect->lower_val = minmax.verint_min;
-        rect->upper_val = minmax.verint_max;
+        for (i = 0; i < n; i++)
+        {
+            if (matches[i])
+                PG_RETURN_TIMESTAMPTZ(Max(batch[i].time, after));
+        }
 
-        retval = palloc(sizeof(GISTENTRY));
-        gistentryinit(*retval, PointerGetDatum(rect), entry->rel, entry->page, entry->offset, false);
-    }
-    else
-    {
-        retval = entry;
+        first += n;
     }
 
-    PG_RETURN_POINTER(retval);
+    PG_RETURN_NULL();
 }
 
 /*
  *
- * versioned_int's gist penalty function
+ * versioned_int_intervals_when(v, op, value) returns tstzmultirange of
+ * times at which "v op value" held. Interval that still holds has no
+ * upper bound.
  *
  */
-Datum versioned_int_penalty(PG_FUNCTION_ARGS)
+Datum versioned_int_intervals_when(PG_FUNCTION_ARGS)
 {
-    GISTENTRY *origentry = (GISTENTRY *)PG_GETARG_POINTER(0);
-    GISTENTRY *newentry = (GISTENTRY *)PG_GETARG_POINTER(1);
-    float *penalty = (float *)PG_GETARG_POINTER(2);
-    verint_rect *origrect = (verint_rect *)DatumGetPointer(origentry->key);
-    verint_rect *newrect = (verint_rect *)DatumGetPointer(newentry->key);
-
-    float8 extra = 0;
-
-    if (newrect->lower_tzbound < origrect->lower_tzbound)
-        extra += (float8)(origrect->lower_tzbound - newrect->lower_tzbound);
-
-    if (newrect->upper_tzbound > origrect->upper_tzbound)
-        extra += (float8)(newrect->upper_tzbound - origrect->upper_tzbound);
-
-    if (newrect->lower_val < origrect->lower_val)
-        extra += (float8)(origrect->lower_val - newrect->lower_val);
-
-    if (newrect->upper_val > origrect->upper_val)
-        extra += (float8)(newrect->upper_val - origrect->upper_val);
-
-    *penalty = (float)extra;
-    PG_RETURN_POINTER(penalty);
+    PG_RETURN_MULTIRANGE_P(verint_intervals_matching(fcinfo, verint_parse_op(PG_GETARG_TEXT_PP(1)),
+                                                     PG_GETARG_INT64(2)));
 }
 
 /*
  *
- * versioned_int's gist same function
+ * versioned_int_times_of(versioned_int, bigint), i.e. versioned_int @? bigint,
+ * returns tstzmultirange of times at which versioned_int held given value.
+ * Values carrying value index answer by binary search over it, others
+ * fall back to a scan like versioned_int_intervals_when(v, '=', value).
  *
  */
-Datum versioned_int_same(PG_FUNCTION_ARGS)
+Datum versioned_int_times_of(PG_FUNCTION_ARGS)
 {
-    verint_rect *r1 = (verint_rect *)PG_GETARG_POINTER(0);
-    verint_rect *r2 = (verint_rect *)PG_GETARG_POINTER(1);
-    bool *result = (bool *)PG_GETARG_POINTER(2);
+    int64 value = PG_GETARG_INT64(1);
+    TypeCacheEntry *typcache;
+    VersionedInt *versionedInt;
+    VersionedIntEntry *entry;
+    RangeType **ranges;
+    RangeBound lower, upper;
+    int32 *index;
+    int32 l, r, nranges = 0;
+
+    versionedInt = verint_fetch_header(PG_GETARG_DATUM(0));
+    if (!(VERINT_FLAGS(versionedInt) & VERINT_FLAG_VALUE_INDEX))
+        PG_RETURN_MULTIRANGE_P(verint_intervals_matching(fcinfo, VERINT_OP_EQ, value));
+
+    versionedInt = verint_detoast(PG_GETARG_DATUM(0));
+    index = VERINT_VALUE_INDEX(versionedInt);
+    l = 0;
+    r = versionedInt->count;
+    while (l < r)
+    {
+        int32 mid = l + (r - l) / 2;
 
-    *result = (r1->lower_tzbound == r2->lower_tzbound) &&
-              (r1->upper_tzbound == r2->upper_tzbound) &&
-              (r1->lower_val == r2->lower_val) &&
-              (r1->upper_val == r2->upper_val);
+        if (verint_entry(versionedInt, index[mid])->value < value)
+            l = mid + 1;
+        else
+            r = mid;
+    }
 
-    // fancy
-    // *result = (memcmp(r1, r2, sizeof(verint_rect)) == 0)
+    typcache = range_get_typcache(fcinfo, TSTZRANGEOID);
+    lower.infinite = false;
+    lower.inclusive = true;
+    lower.lower = true;
+    upper.inclusive = false;
+    upper.lower = false;
 
-    PG_RETURN_POINTER(result);
+    /* Entries of equal value are in time order, so ranges come sorted */
+    ranges = (RangeType **)palloc((versionedInt->count - l + 1) * sizeof(RangeType *));
+    for (; l < versionedInt->count; l++)
+    {
+        entry = verint_entry(versionedInt, index[l]);
+        if (entry->value != value)
+            break;
+
+        lower.val = TimestampTzGetDatum(entry->time);
+        upper.infinite = index[l] == versionedInt->count - 1;
+        upper.val = upper.infinite ? (Datum)0 : TimestampTzGetDatum(verint_entry(versionedInt, index[l] + 1)->time);
+        ranges[nranges++] = make_range(typcache, &lower, &upper, false, NULL);
+    }
+
+    PG_RETURN_MULTIRANGE_P(make_multirange(TSTZMULTIRANGEOID, typcache, nranges, ranges));
 }
 
 /*
  *
- * versioned_int's gist picksplit function
+ * versioned_int_set_value_index turns value index of a versioned_int on
+ * or off. It costs 4 more bytes per entry, and an append moves part of
+ * index to keep it sorted, so it suits low churn histories queried by
+ * value, like
+ * UPDATE t SET v = versioned_int_set_value_index(v, true)
  *
  */
-static inline float8 get_area(const verint_rect *r)
+Datum versioned_int_set_value_index(PG_FUNCTION_ARGS)
 {
-    return (float8)(r->upper_tzbound - r->lower_tzbound) *
-           (float8)(r->upper_val - r->lower_val);
-}
+    Datum srcDatum = PG_GETARG_DATUM(0);
+    VersionedInt *src;
+    int32 flags;
 
-static inline float8 get_union_area(const verint_rect *r1, const verint_rect *r2)
+    if (PG_GETARG_BOOL(1) && verint_split_tail_cap(srcDatum) > 0)
+    {
+        verint_split_layout_error();
+    }
+
+    src = verint_detoast(srcDatum);
+    flags = VERINT_FLAGS(src) & ~VERINT_FLAG_VALUE_INDEX;
+    if (PG_GETARG_BOOL(1))
+    {
+        flags |= VERINT_FLAG_VALUE_INDEX;
+    }
+
+    if (flags == VERINT_FLAGS(src))
+    {
+        PG_RETURN_DATUM(srcDatum);
+    }
+
+    PG_RETURN_POINTER(verint_relayout(src, flags));
+}
+
+/*
+ *
+ * versioned_int_resample(v, origin, width, from, to, agg) resamples
+ * history onto grid of buckets [origin + k * width, origin + (k + 1) * width)
+ * covering [from, to). For each bucket it returns value at bucket's start
+ * ('at') or first, last, min or max value of the step function within
+ * bucket. Values carry forward into buckets with no entries. Buckets and
+ * entries are co-iterated once, with entries read in batches; buckets
+ * before versioned_int existed get null.
+ *
+ */
+Datum versioned_int_resample(PG_FUNCTION_ARGS)
+{
+    ReturnSetInfo *rsinfo = (ReturnSetInfo *)fcinfo->resultinfo;
+    TimestampTz origin = PG_GETARG_TIMESTAMPTZ(1);
+    Interval *interval = PG_GETARG_INTERVAL_P(2);
+    TimestampTz from = PG_GETARG_TIMESTAMPTZ(3);
+    TimestampTz to = PG_GETARG_TIMESTAMPTZ(4);
+    char *agg = text_to_cstring(PG_GETARG_TEXT_PP(5));
+    VerintReader reader;
+    VerintRangeStats stats;
+    VersionedIntEntry *batch;
+    VersionedIntEntry prev;
+    VersionedIntEntry head = {0, 0};
+    TimestampTz bucket, bucketEnd, lastEnd;
+    int64 width, value;
+    Datum values[2];
+    bool nulls[2] = {false, false};
+    int32 first, end, n, pos;
+    bool havePrev = false;
+
+    if (interval->month != 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                errmsg("resample interval must not have months or years"));
+    }
+    width = interval->time + (int64)interval->day * USECS_PER_DAY;
+    if (width <= 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                errmsg("resample interval must be positive"));
+    }
+    if (TIMESTAMP_NOT_FINITE(origin) || TIMESTAMP_NOT_FINITE(from) || TIMESTAMP_NOT_FINITE(to))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                errmsg("resample bounds must be finite"));
+    }
+    if (strcmp(agg, "at") != 0 && strcmp(agg, "first") != 0 && strcmp(agg, "last") != 0 &&
+        strcmp(agg, "min") != 0 && strcmp(agg, "max") != 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                errmsg("unknown resample aggregate \"%s\"", agg),
+                errhint("Valid aggregates are at, first, last, min and max."));
+    }
+
+    InitMaterializedSRF(fcinfo, 0);
+
+    if (to <= from)
+        return (Datum)0;
+
+    bucket = origin + floor_div(from - origin, width) * width;
+    lastEnd = bucket + ((to - bucket + width - 1) / width) * width;
+
+    verint_reader_init(&reader, PG_GETARG_DATUM(0));
+    if (reader.hdr->count > 0)
+    {
+        verint_reader_fetch(&reader, 0, 1, &head);
+    }
+
+    first = Max(verint_reader_search(&reader, bucket, true) - 1, 0);
+    end = verint_reader_search(&reader, lastEnd, false);
+
+    batch = (VersionedIntEntry *)palloc(Min(Max(end - first, 1), VERINT_READER_BATCH) * sizeof(VersionedIntEntry));
+    n = pos = 0;
+    for (; bucket < to; bucket += width)
+    {
+        bucketEnd = bucket + width;
+
+        memset(&stats, 0, sizeof(VerintRangeStats));
+        stats.min = PG_INT64_MAX;
+        stats.max = PG_INT64_MIN;
+
+        for (;;)
+        {
+            if (pos == n)
+            {
+                if (first >= end)
+                    break;
+
+                n = Min(end - first, VERINT_READER_BATCH);
+                verint_reader_fetch(&reader, first, n, batch);
+                first += n;
+                pos = 0;
+            }
+            if (batch[pos].time >= bucketEnd)
+                break;
+
+            if (havePrev)
+                accumulate_step(&stats, prev.value, Max(prev.time, bucket), batch[pos].time, VERINT_INT8);
+
+            prev = batch[pos++];
+            havePrev = true;
+        }
+
+        if (havePrev)
+            accumulate_step(&stats, prev.value, Max(prev.time, bucket), bucketEnd, VERINT_INT8);
+
+        if (agg[0] == 'a')
+        {
+            /* First step starts at bucket's start only if history existed then */
+            nulls[1] = stats.covered == 0 || head.time > bucket;
+            value = stats.first;
+        }
+        else
+        {
+            nulls[1] = stats.covered == 0;
+            value = agg[0] == 'f' ? stats.first : agg[0] == 'l' ? stats.last : agg[1] == 'i' ? stats.min : stats.max;
+        }
+
+        values[0] = TimestampTzGetDatum(bucket);
+        values[1] = Int64GetDatum(value);
+
+        tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+    }
+    pfree(batch);
+
+    return (Datum)0;
+}
+
+/*
+ *
+ * versioned_int_lttb(v, n_points, tstzrange) downsamples entries within
+ * range to at most n_points with Largest-Triangle-Three-Buckets, keeping
+ * the points that preserve visual shape of the series. First and last
+ * entries are always kept. Result is a pair of parallel arrays.
+ *
+ */
+Datum versioned_int_lttb(PG_FUNCTION_ARGS)
+{
+    int32 nPoints = PG_GETARG_INT32(1);
+    VersionedInt *data = verint_fetch_range_arg(fcinfo, 2);
+    VersionedIntEntry *points;
+    VersionedIntEntry *entries;
+    float8 every, avgX, avgY, ax, ay, area, maxArea;
+    int32 n, i, j, a, k, avgStart, avgEnd, rangeStart, rangeEnd, chosen;
+
+    if (data == NULL)
+        return verint_points_result(fcinfo, NULL, 0);
+
+    n = data->count;
+    entries = data->entries;
+    if (n <= nPoints)
+        return verint_points_result(fcinfo, entries, n);
+
+    /* x is time relative to first entry, to keep precision of float8 */
+    points = (VersionedIntEntry *)palloc(nPoints * sizeof(VersionedIntEntry));
+    points[0] = entries[0];
+    every = (float8)(n - 2) / (nPoints - 2);
+    a = 0;
+    k = 1;
+    for (i = 0; i < nPoints - 2; i++)
+    {
+        avgStart = (int32)floor((i + 1) * every) + 1;
+        avgEnd = Min((int32)floor((i + 2) * every) + 1, n);
+        avgX = avgY = 0;
+        for (j = avgStart; j < avgEnd; j++)
+        {
+            avgX += (float8)(entries[j].time - entries[0].time);
+            avgY += (float8)entries[j].value;
+        }
+        avgX /= avgEnd - avgStart;
+        avgY /= avgEnd - avgStart;
+
+        rangeStart = (int32)floor(i * every) + 1;
+        rangeEnd = (int32)floor((i + 1) * every) + 1;
+        ax = (float8)(entries[a].time - entries[0].time);
+        ay = (float8)entries[a].value;
+        maxArea = -1;
+        chosen = rangeStart;
+        for (j = rangeStart; j < rangeEnd; j++)
+        {
+            area = fabs((ax - avgX) * ((float8)entries[j].value - ay) -
+                        (ax - (float8)(entries[j].time - entries[0].time)) * (avgY - ay));
+            if (area > maxArea)
+            {
+                maxArea = area;
+                chosen = j;
+            }
+        }
+
+        points[k++] = entries[chosen];
+        a = chosen;
+    }
+    points[k++] = entries[n - 1];
+
+    return verint_points_result(fcinfo, points, k);
+}
+
+/*
+ *
+ * versioned_int_minmax_downsample(v, n_buckets, tstzrange) splits entries
+ * within range into n_buckets buckets of equal entry count and keeps the
+ * entries holding each bucket's minimum and maximum, in time order, so
+ * spikes are never lost. Result is a pair of parallel arrays.
+ *
+ */
+Datum versioned_int_minmax_downsample(PG_FUNCTION_ARGS)
+{
+    int32 nBuckets = PG_GETARG_INT32(1);
+    VersionedInt *data = verint_fetch_range_arg(fcinfo, 1);
+    VersionedIntEntry *points;
+    VersionedIntEntry *entries;
+    int32 n, i, j, k, start, end, minIdx, maxIdx;
+
+    if (data == NULL)
+        return verint_points_result(fcinfo, NULL, 0);
+
+    n = data->count;
+    entries = data->entries;
+    if (n <= 2 * (int64)nBuckets)
+        return verint_points_result(fcinfo, entries, n);
+
+    points = (VersionedIntEntry *)palloc(2 * (Size)nBuckets * sizeof(VersionedIntEntry));
+    k = 0;
+    for (i = 0; i < nBuckets; i++)
+    {
+        start = (int32)((int64)n * i / nBuckets);
+        end = (int32)((int64)n * (i + 1) / nBuckets);
+        minIdx = maxIdx = start;
+        for (j = start + 1; j < end; j++)
+        {
+            if (entries[j].value < entries[minIdx].value)
+                minIdx = j;
+            if (entries[j].value > entries[maxIdx].value)
+                maxIdx = j;
+        }
+
+        points[k++] = entries[Min(minIdx, maxIdx)];
+        if (minIdx != maxIdx)
+            points[k++] = entries[Max(minIdx, maxIdx)];
+    }
+
+    return verint_points_result(fcinfo, points, k);
+}
+
+/*
+ *
+ * Function that is used for comparing versioned_int with composite (timestamp, value).
+ * In sql that would look like versioned_int @= (timestamp, value).
+ *
+ */
+Datum versioned_int_at_time_eq(PG_FUNCTION_ARGS)
+{
+    return verint_at_time_op(fcinfo, 1, VERINT_INT8);
+}
+
+Datum versioned_int_at_time_lt(PG_FUNCTION_ARGS)
+{
+    return verint_at_time_op(fcinfo, 2, VERINT_INT8);
+}
+
+Datum versioned_int_at_time_gt(PG_FUNCTION_ARGS)
+{
+    return verint_at_time_op(fcinfo, 3, VERINT_INT8);
+}
+
+Datum versioned_int_at_time_le(PG_FUNCTION_ARGS)
+{
+    return verint_at_time_op(fcinfo, 4, VERINT_INT8);
+}
+
+Datum versioned_int_at_time_ge(PG_FUNCTION_ARGS)
+{
+    return verint_at_time_op(fcinfo, 5, VERINT_INT8);
+}
+
+/*
+ *
+ * Compares value history had at query's time with query's value, for
+ * ts_int queries of versioned_int and ts_float8 ones of versioned_float8.
+ * Strategy numbers are the ones of gist_versioned_int_ops.
+ *
+ */
+static Datum verint_at_time_op(FunctionCallInfo fcinfo, StrategyNumber strategy, VerintValueType type)
+{
+    VersionedIntEntry *query = verint_ts_int_query(fcinfo, PG_GETARG_DATUM(1), type);
+    VersionedIntEntry entry;
+
+    if (!verint_lookup_at(PG_GETARG_DATUM(0), query->time, &entry))
+    {
+        PG_RETURN_NULL();
+    }
+
+    PG_RETURN_BOOL(verint_compare(entry.value, query->value, strategy));
+}
+
+/*
+ *
+ * Decodes ts_int composite query, or ts_float8 one for versioned_float8,
+ * into (time, value). Result is cached in
+ * fn_extra, so an index scan or a join that passes the same query over
+ * and over looks attributes up by name only once. Cache is keyed on
+ * query's pointer and checked against a copy of its bytes, since memory
+ * of a previous query may be reused by a new one.
+ *
+ */
+static VersionedIntEntry *verint_ts_int_query(FunctionCallInfo fcinfo, Datum query, VerintValueType type)
+{
+    VerintQueryCache *cache = (VerintQueryCache *)fcinfo->flinfo->fn_extra;
+    HeapTupleHeader t = DatumGetHeapTupleHeader(query);
+    uint32 len = HeapTupleHeaderGetDatumLength(t);
+    Datum timestampDatum, valueDatum;
+    bool isNull;
+
+    if (cache != NULL && cache->query == query && cache->len == len &&
+        memcmp(cache->tuple, t, len) == 0)
+    {
+        return &cache->point;
+    }
+
+    timestampDatum = GetAttributeByName(t, "ts", &isNull);
+    if (isNull)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("ts cannot be null")));
+    }
+
+    valueDatum = GetAttributeByName(t, "value", &isNull);
+    if (isNull)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("value cannot be null")));
+    }
+
+    if (cache == NULL)
+    {
+        cache = (VerintQueryCache *)MemoryContextAllocZero(fcinfo->flinfo->fn_mcxt, sizeof(VerintQueryCache));
+        fcinfo->flinfo->fn_extra = cache;
+    }
+    if (cache->len < len)
+    {
+        if (cache->tuple != NULL)
+            pfree(cache->tuple);
+        cache->tuple = (char *)MemoryContextAlloc(fcinfo->flinfo->fn_mcxt, len);
+    }
+
+    memcpy(cache->tuple, t, len);
+    cache->len = len;
+    cache->query = query;
+    cache->point.time = DatumGetTimestampTz(timestampDatum);
+    cache->point.value = verint_datum_value(valueDatum, type);
+
+    return &cache->point;
+}
+
+/*
+ *
+ * verint_point is a fixed length (timestamp, value) pair, stored as
+ * VersionedIntEntry. It's the query type of @=, @<, @>, @<= and @>=
+ * overloads that read both fields directly instead of looking up
+ * attributes of ts_int composite. Text form is (timestamp,value); as
+ * such literal also fits ts_int, it has to be cast to verint_point.
+ *
+ */
+Datum verint_point_in(PG_FUNCTION_ARGS)
+{
+    char *input = PG_GETARG_CSTRING(0);
+    char *str = pstrdup(input);
+    char *start, *end, *comma;
+    VersionedIntEntry *point;
+
+    start = str;
+    while (isspace((unsigned char)*start))
+        start++;
+    end = str + strlen(str);
+    while (end > start && isspace((unsigned char)end[-1]))
+        end--;
+
+    comma = NULL;
+    if (*start == '(' && end - start > 2 && end[-1] == ')')
+    {
+        *--end = '\0';
+        comma = strrchr(++start, ',');
+    }
+    if (comma == NULL)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+                 errmsg("invalid input syntax for type verint_point: \"%s\"", input)));
+    }
+    *comma = '\0';
+
+    /* Timestamp may come quoted, as it does in ts_int's text form */
+    end = comma;
+    if (*start == '"' && end - start > 1 && end[-1] == '"')
+    {
+        start++;
+        *--end = '\0';
+    }
+
+    point = (VersionedIntEntry *)palloc(sizeof(VersionedIntEntry));
+    point->time = DatumGetTimestampTz(DirectFunctionCall3(timestamptz_in, CStringGetDatum(start),
+                                                          ObjectIdGetDatum(InvalidOid), Int32GetDatum(-1)));
+    point->value = pg_strtoint64(comma + 1);
+
+    PG_RETURN_POINTER(point);
+}
+
+Datum verint_point_out(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry *point = (VersionedIntEntry *)PG_GETARG_POINTER(0);
+    char *time = DatumGetCString(DirectFunctionCall1(timestamptz_out, TimestampTzGetDatum(point->time)));
+
+    PG_RETURN_CSTRING(psprintf("(%s,%ld)", time, point->value));
+}
+
+/*
+ *
+ * Constructor of verint_point, i.e. verint_point(timestamp, value)
+ *
+ */
+Datum verint_point_make(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry *point = (VersionedIntEntry *)palloc(sizeof(VersionedIntEntry));
+
+    point->time = PG_GETARG_TIMESTAMPTZ(0);
+    point->value = PG_GETARG_INT64(1);
+
+    PG_RETURN_POINTER(point);
+}
+
+Datum versioned_int_at_point_eq(PG_FUNCTION_ARGS)
+{
+    return verint_point_op(fcinfo, 1);
+}
+
+Datum versioned_int_at_point_lt(PG_FUNCTION_ARGS)
+{
+    return verint_point_op(fcinfo, 2);
+}
+
+Datum versioned_int_at_point_gt(PG_FUNCTION_ARGS)
+{
+    return verint_point_op(fcinfo, 3);
+}
+
+Datum versioned_int_at_point_le(PG_FUNCTION_ARGS)
+{
+    return verint_point_op(fcinfo, 4);
+}
+
+Datum versioned_int_at_point_ge(PG_FUNCTION_ARGS)
+{
+    return verint_point_op(fcinfo, 5);
+}
+
+/*
+ *
+ * Compares value versioned_int had at point's time with point's value,
+ * strategy numbers are the ones of gist_versioned_int_ops.
+ *
+ */
+static Datum verint_point_op(FunctionCallInfo fcinfo, StrategyNumber strategy)
+{
+    VersionedIntEntry *point = (VersionedIntEntry *)PG_GETARG_POINTER(1);
+    VersionedIntEntry entry;
+
+    if (!verint_lookup_at(PG_GETARG_DATUM(0), point->time, &entry))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(verint_compare(entry.value, point->value, strategy));
+}
+
+/*
+ *
+ * Compares a with b as strategy 1 - 5 of gist_versioned_int_ops does.
+ *
+ */
+static bool verint_compare(int64 a, int64 b, StrategyNumber strategy)
+{
+    switch (strategy)
+    {
+    case 1:
+        return a == b;
+    case 2:
+        return a < b;
+    case 3:
+        return a > b;
+    case 4:
+        return a <= b;
+    default:
+        return a >= b;
+    }
+}
+
+/*
+ *
+ * Output function for versioned_int, i.e. function that turns
+ * type's internal representation to string. Here we just get
+ * versioned_int's current value.
+ *
+ */
+Datum versioned_int_out(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    char *result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+    {
+        result = psprintf("NULL");
+    }
+    else
+    {
+        result = psprintf("%ld", current.value);
+    }
+    PG_RETURN_CSTRING(result);
+}
+
+/*
+ *
+ * GIST INDEX METHOD SUPPORT FOR VERSIONED_INT
+ *
+ */
+Datum verint_rect_in(PG_FUNCTION_ARGS)
+{
+    ereport(ERROR,
+            (errcode(ERRCODE_FEATURE_NOT_SUPPORTED)),
+            errmsg("Conversion between text representation and verint_rect is not possible"));
+}
+
+Datum verint_rect_out(PG_FUNCTION_ARGS)
+{
+    verint_rect *rect = (verint_rect *)PG_GETARG_POINTER(0);
+
+    char *result = psprintf("%ld,%ld,%ld,%ld",
+                            rect->lower_tzbound,
+                            rect->upper_tzbound,
+                            rect->lower_val,
+                            rect->upper_val);
+
+    PG_RETURN_CSTRING(result);
+}
+
+/*
+ *
+ * versioned_int's gist consistency function
+ *
+ */
+Datum versioned_int_consistent(PG_FUNCTION_ARGS)
+{
+    return versioned_int_consistent_internal(fcinfo, VERINT_INT8);
+}
+
+static pg_attribute_always_inline Datum versioned_int_consistent_internal(FunctionCallInfo fcinfo,
+                                                                          VerintValueType type)
+{
+    GISTENTRY *entry = (GISTENTRY *)PG_GETARG_POINTER(0);
+    Datum query_datum = PG_GETARG_DATUM(1);
+    StrategyNumber strategy = (StrategyNumber)PG_GETARG_UINT16(2);
+    bool *recheck = (bool *)PG_GETARG_POINTER(4);
+    verint_rect *key = (verint_rect *)DatumGetPointer(entry->key);
+    VersionedIntEntry *point;
+
+    /* Strategies 6 - 10 are the verint_point overloads of 1 - 5 */
+    if (strategy > 5)
+    {
+        point = (VersionedIntEntry *)DatumGetPointer(query_datum);
+        PG_RETURN_BOOL(verint_rect_consistent(key, point->time, point->value, strategy - 5,
+                                              GIST_LEAF(entry), recheck));
+    }
+
+    /* Composite is decoded once per scan, see verint_ts_int_query */
+    point = verint_ts_int_query(fcinfo, query_datum, type);
+
+    PG_RETURN_BOOL(verint_rect_consistent(key, point->time, point->value, strategy, GIST_LEAF(entry), recheck));
+}
+
+/*
+ *
+ * Tests whether index key may hold a versioned_int whose value at time_at
+ * compares with value as strategy 1 - 5 requires.
+ *
+ */
+static bool verint_rect_consistent(const verint_rect *key, TimestampTz time_at, int64 value,
+                                   StrategyNumber strategy, bool leaf, bool *recheck)
+{
+    if (time_at < key->lower_tzbound || time_at > key->upper_tzbound)
+    {
+        *recheck = false;
+        return false;
+    }
+
+    switch (strategy)
+    {
+    case 1: // @=
+        if (key->lower_val <= value && value <= key->upper_val)
+        {
+            *recheck = leaf;
+            return true;
+        }
+        break;
+
+    case 2: // @<
+        if (key->lower_val < value)
+        {
+            *recheck = leaf;
+            return true;
+        }
+        break;
+
+    case 3: // @>
+        if (key->upper_val > value)
+        {
+            *recheck = leaf;
+            return true;
+        }
+        break;
+
+    case 4: // @<=
+        if (key->lower_val <= value)
+        {
+            *recheck = leaf;
+            return true;
+        }
+        break;
+
+    case 5: // @>=
+        if (key->upper_val >= value)
+        {
+            *recheck = leaf;
+            return true;
+        }
+        break;
+
+    default:
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+                 errmsg("gist index access method strategy not supported")));
+    }
+
+    *recheck = false;
+    return false;
+}
+
+/*
+ *
+ * versioned_int's gist union function
+ *
+ */
+Datum versioned_int_union(PG_FUNCTION_ARGS)
+{
+    int i;
+    verint_rect *nodeentry;
+    GistEntryVector *entryvec = (GistEntryVector *)PG_GETARG_POINTER(0);
+    GISTENTRY *ent = entryvec->vector;
+    int n = entryvec->n;
+    verint_rect *ret = (verint_rect *)palloc0(sizeof(verint_rect));
+
+    ret->lower_tzbound = PG_INT64_MAX;
+    ret->upper_tzbound = PG_INT64_MIN;
+    ret->lower_val = PG_INT64_MAX;
+    ret->upper_val = PG_INT64_MIN;
+
+    for (i = 0; i < n; i++)
+    {
+        nodeentry = (verint_rect *)DatumGetPointer(ent[i].key);
+        ret->lower_tzbound = Min(ret->lower_tzbound, nodeentry->lower_tzbound);
+        ret->upper_tzbound = Max(ret->upper_tzbound, nodeentry->upper_tzbound);
+        ret->lower_val = Min(ret->lower_val, nodeentry->lower_val);
+        ret->upper_val = Max(ret->upper_val, nodeentry->upper_val);
+    }
+
+    PG_RETURN_POINTER(ret);
+}
+
+/*
+ *
+ * versioned_int's gist compress function
+ *
+ */
+Datum versioned_int_compress(PG_FUNCTION_ARGS)
+{
+    GISTENTRY *retval;
+    verint_rect *rect;
+    VersionedInt *verint;
+    GISTENTRY *entry = (GISTENTRY *)PG_GETARG_POINTER(0);
+    VerintMinMax minmax;
+
+    if (entry->leafkey)
+    {
+        rect = (verint_rect *)palloc(sizeof(verint_rect));
+        verint = verint_detoast(entry->key);
+
+        rect->lower_tzbound = verint_entry(verint, 0)->time;
+        rect->upper_tzbound = PG_INT64_MAX - 1;
+        minmax = get_versioned_ints_min_max(verint);
+        rect->lower_val = minmax.verint_min;
+        rect->upper_val = minmax.verint_max;
+
+        retval = palloc(sizeof(GISTENTRY));
+        gistentryinit(*retval, PointerGetDatum(rect), entry->rel, entry->page, entry->offset, false);
+    }
+    else
+    {
+        retval = entry;
+    }
+
+    PG_RETURN_POINTER(retval);
+}
+
+/*
+ *
+ * versioned_int's gist penalty function
+ *
+ */
+Datum versioned_int_penalty(PG_FUNCTION_ARGS)
+{
+    GISTENTRY *origentry = (GISTENTRY *)PG_GETARG_POINTER(0);
+    GISTENTRY *newentry = (GISTENTRY *)PG_GETARG_POINTER(1);
+    float *penalty = (float *)PG_GETARG_POINTER(2);
+    verint_rect *origrect = (verint_rect *)DatumGetPointer(origentry->key);
+    verint_rect *newrect = (verint_rect *)DatumGetPointer(newentry->key);
+
+    float8 extra = 0;
+
+    if (newrect->lower_tzbound < origrect->lower_tzbound)
+        extra += (float8)(origrect->lower_tzbound - newrect->lower_tzbound);
+
+    if (newrect->upper_tzbound > origrect->upper_tzbound)
+        extra += (float8)(newrect->upper_tzbound - origrect->upper_tzbound);
+
+    if (newrect->lower_val < origrect->lower_val)
+        extra += (float8)(origrect->lower_val - newrect->lower_val);
+
+    if (newrect->upper_val > origrect->upper_val)
+        extra += (float8)(newrect->upper_val - origrect->upper_val);
+
+    *penalty = (float)extra;
+    PG_RETURN_POINTER(penalty);
+}
+
+/*
+ *
+ * versioned_int's gist same function
+ *
+ */
+Datum versioned_int_same(PG_FUNCTION_ARGS)
+{
+    verint_rect *r1 = (verint_rect *)PG_GETARG_POINTER(0);
+    verint_rect *r2 = (verint_rect *)PG_GETARG_POINTER(1);
+    bool *result = (bool *)PG_GETARG_POINTER(2);
+
+    *result = (r1->lower_tzbound == r2->lower_tzbound) &&
+              (r1->upper_tzbound == r2->upper_tzbound) &&
+              (r1->lower_val == r2->lower_val) &&
+              (r1->upper_val == r2->upper_val);
+
+    // fancy
+    // *result = (memcmp(r1, r2, sizeof(verint_rect)) == 0)
+
+    PG_RETURN_POINTER(result);
+}
+
+/*
+ *
+ * versioned_int's gist picksplit function
+ *
+ */
+static inline float8 get_area(const verint_rect *r)
+{
+    return (float8)(r->upper_tzbound - r->lower_tzbound) *
+           (float8)(r->upper_val - r->lower_val);
+}
+
+static inline float8 get_union_area(const verint_rect *r1, const verint_rect *r2)
+{
+    TimestampTz lo_t = Min(r1->lower_tzbound, r2->lower_tzbound);
+    TimestampTz hi_t = Max(r1->upper_tzbound, r2->upper_tzbound);
+    int64 lo_v = Min(r1->lower_val, r2->lower_val);
+    int64 hi_v = Max(r1->upper_val, r2->upper_val);
+
+    return (float8)(hi_t - lo_t) * (float8)(hi_v - lo_v);
+}
+
+static inline void get_union_rect(const verint_rect *r1, const verint_rect *r2, verint_rect *dst)
+{
+    dst->lower_tzbound = Min(r1->lower_tzbound, r2->lower_tzbound);
+    dst->upper_tzbound = Max(r1->upper_tzbound, r2->upper_tzbound);
+    dst->lower_val = Min(r1->lower_val, r2->lower_val);
+    dst->upper_val = Max(r1->upper_val, r2->upper_val);
+}
+
+Datum versioned_int_picksplit(PG_FUNCTION_ARGS)
+{
+    GistEntryVector *entryvec = (GistEntryVector *)PG_GETARG_POINTER(0);
+    GIST_SPLITVEC *v = (GIST_SPLITVEC *)PG_GETARG_POINTER(1);
+
+    OffsetNumber maxoff = entryvec->n - 1;
+    OffsetNumber i, j;
+    int nbytes;
+    verint_rect *unionL, *unionR, *r, tmpL, tmpR;
+    float8 enlargementL, enlargementR;
+
+    int seed1 = -1, seed2 = -1;
+    float8 worst_waste = -1;
+
+    for (i = FirstOffsetNumber; i < maxoff; i = OffsetNumberNext(i))
+    {
+        verint_rect *r1 = (verint_rect *)DatumGetPointer(entryvec->vector[i].key);
+        for (j = OffsetNumberNext(i); j <= maxoff; j = OffsetNumberNext(j))
+        {
+            verint_rect *r2 = (verint_rect *)DatumGetPointer(entryvec->vector[j].key);
+
+            float8 area1 = get_area(r1);
+            float8 area2 = get_area(r2);
+            float8 union_area = get_union_area(r1, r2);
+            float8 waste = union_area - area1 - area2;
+
+            if (waste > worst_waste)
+            {
+                worst_waste = waste;
+                seed1 = i;
+                seed2 = j;
+            }
+        }
+    }
+
+    nbytes = (maxoff + 1) * sizeof(OffsetNumber);
+    v->spl_left = (OffsetNumber *)palloc(nbytes);
+    v->spl_right = (OffsetNumber *)palloc(nbytes);
+    v->spl_nleft = v->spl_nright = 0;
+
+    unionL = (verint_rect *)palloc(sizeof(verint_rect));
+    unionR = (verint_rect *)palloc(sizeof(verint_rect));
+    *unionL = *(verint_rect *)DatumGetPointer(entryvec->vector[seed1].key);
+    *unionR = *(verint_rect *)DatumGetPointer(entryvec->vector[seed2].key);
+
+    v->spl_left[v->spl_nleft++] = seed1;
+    v->spl_right[v->spl_nright++] = seed2;
+
+    for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+    {
+        if (i == seed1 || i == seed2)
+            continue;
+
+        r = (verint_rect *)DatumGetPointer(entryvec->vector[i].key);
+
+        tmpL = *unionL;
+        tmpR = *unionR;
+        get_union_rect(unionL, r, &tmpL);
+        get_union_rect(unionR, r, &tmpR);
+
+        enlargementL = get_area(&tmpL) - get_area(unionL);
+        enlargementR = get_area(&tmpR) - get_area(unionR);
+
+        if (enlargementL < enlargementR ||
+            (enlargementL == enlargementR && get_area(unionL) < get_area(unionR)))
+        {
+            v->spl_left[v->spl_nleft++] = i;
+            *unionL = tmpL;
+        }
+        else
+        {
+            v->spl_right[v->spl_nright++] = i;
+            *unionR = tmpR;
+        }
+    }
+
+    v->spl_ldatum = PointerGetDatum(unionL);
+    v->spl_rdatum = PointerGetDatum(unionR);
+
+    PG_RETURN_POINTER(v);
+}
+
+/*
+ *
+ * Some Btree index method functions so that versioned_int could use
+ * ORDER BY, DISTINCT etc.
+ *
+ */
+static int versioned_int_cmp_internal(int64 av, int64 bv)
+{
+    if (av < bv)
+    {
+        return -1;
+    }
+    if (av > bv)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+Datum versioned_int_btree_cmp(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_INT32(versioned_int_cmp_current(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)));
+}
+
+/*
+ *
+ * Orders versioned_ints by their current values. Empty histories, which
+ * have none, sort before all others and equal to each other.
+ *
+ */
+static int versioned_int_cmp_current(Datum a, Datum b)
+{
+    VersionedIntEntry currentA;
+    VersionedIntEntry currentB;
+    bool hasA = verint_fetch_last(a, &currentA);
+    bool hasB = verint_fetch_last(b, &currentB);
+
+    if (!hasA || !hasB)
+        return (int)hasA - (int)hasB;
+
+    return versioned_int_cmp_internal(currentA.value, currentB.value);
+}
+
+static int32 get_ts_insert_location(VersionedInt *versionedInt, TimestampTz time)
+{
+    int32 l = 0;
+    int32 r = versionedInt->count;
+
+    while (l < r)
+    {
+        int32 mid = l + (r - l) / 2;
+
+        if (verint_entry(versionedInt, mid)->time < time)
+        {
+            l = mid + 1;
+        }
+        else
+        {
+            r = mid;
+        }
+    }
+
+    return l;
+}
+
+/*
+ *
+ * Keeps newest maxCap entries in a bounded value of exactly maxCap slots,
+ * so that following appends grow it by one slot instead of doubling it.
+ * A bounded value smaller than maxCap (it was bounded by some other
+ * column) is unbounded again so it can grow up to new limit.
+ *
+ */
+static VersionedInt *enforce_N_retention(VersionedInt *versionedInt, int32 maxCap)
+{
+    VersionedInt *newVerint;
+    int32 newCap;
+    int32 drop;
+
+    if (versionedInt->cap == maxCap ||
+        (versionedInt->cap < maxCap && !(VERINT_FLAGS(versionedInt) & VERINT_FLAG_BOUNDED)))
+    {
+        return versionedInt;
+    }
+
+    newCap = Min(versionedInt->cap, maxCap);
+    newVerint = verint_alloc(newCap, Min(versionedInt->count, newCap),
+                             (newCap == maxCap ? VERINT_FLAG_BOUNDED : 0) |
+                                 (VERINT_FLAGS(versionedInt) & VERINT_LAYOUT_MASK));
+    drop = versionedInt->count - newVerint->count;
+
+    verint_copy_entries(newVerint->entries, versionedInt, drop, newVerint->count);
+    verint_copy_prefix(VERINT_PREFIX(newVerint), versionedInt, drop, newVerint->count);
+    verint_copy_value_index(VERINT_VALUE_INDEX(newVerint), versionedInt, drop);
+
+    return newVerint;
+}
+
+static int32 first_time_greater_than_cutoff(VersionedInt *versionedInt, TimestampTz cutoff)
+{
+    int32 l = 0;
+    int32 r = versionedInt->count - 1;
+    int32 result = versionedInt->count;
+
+    while (l <= r)
+    {
+        int32 mid = l + (r - l) / 2;
+        if (verint_entry(versionedInt, mid)->time > cutoff)
+        {
+            result = mid;
+            r = mid - 1;
+        }
+        else
+        {
+            l = mid + 1;
+        }
+    }
+
+    return result;
+}
+
+static VersionedInt *enforce_Time_retention(VersionedInt *versionedInt, int64 time)
+{
+    TimestampTz cutoffTime = GetCurrentTimestamp() - time;
+    int32 idx = first_time_greater_than_cutoff(versionedInt, cutoffTime);
+    int32 newCount;
+    VersionedInt *newVerint;
+
+    if (idx == 0)
+        return versionedInt;
+
+    newCount = versionedInt->count - idx;
+
+    newVerint = verint_alloc(newCount, newCount, VERINT_FLAGS(versionedInt) & VERINT_LAYOUT_MASK);
+    verint_copy_entries(newVerint->entries, versionedInt, idx, newCount);
+    verint_copy_prefix(VERINT_PREFIX(newVerint), versionedInt, idx, newCount);
+    verint_copy_value_index(VERINT_VALUE_INDEX(newVerint), versionedInt, idx);
+
+    return newVerint;
+}
+
+/*
+ *
+ * Size versioned_int would take once compressed with default TOAST
+ * compression method, or its raw size if it doesn't compress.
+ *
+ */
+static Size verint_compressed_size(VersionedInt *versionedInt)
+{
+    struct varlena *compressed;
+    Size size;
+
+    if (default_toast_compression == TOAST_LZ4_COMPRESSION)
+        compressed = lz4_compress_datum((struct varlena *)versionedInt);
+    else
+        compressed = pglz_compress_datum((struct varlena *)versionedInt);
+
+    if (compressed == NULL)
+        return VARSIZE(versionedInt);
+
+    size = VARSIZE(compressed);
+    pfree(compressed);
+
+    return size;
+}
+
+/*
+ *
+ * Evicts oldest entries until versioned_int's stored size fits into
+ * budget bytes. Compression is accounted for only above TOAST threshold,
+ * since smaller values are stored uncompressed by the toaster anyway.
+ * Count of entries that fit compressed is estimated from compression
+ * ratio of the whole history and verified by compressing the candidate,
+ * shrinking it by the ratio it actually got until it fits, so usually
+ * two compressions are done. When compression doesn't buy any extra
+ * entries, result is bounded to as many entries as fit raw, so
+ * following appends grow it by one slot instead of doubling it.
+ *
+ */
+static VersionedInt *enforce_Byte_retention(VersionedInt *versionedInt, int32 budget)
+{
+    VersionedInt *newVerint;
+    int32 layoutFlags = VERINT_FLAGS(versionedInt) & VERINT_LAYOUT_MASK;
+    int32 rawMax = (int32)((budget - VERINT_HDRSZ) / VERINT_SLOT_SIZE(layoutFlags));
+    int32 lo = Min(rawMax, versionedInt->count);
+    int32 est;
+    Size size;
+
+    if (VARSIZE(versionedInt) <= (Size)budget)
+        return versionedInt;
+
+    if (VARSIZE(versionedInt) > TOAST_TUPLE_THRESHOLD)
+    {
+        size = verint_compressed_size(versionedInt);
+        if (size <= (Size)budget)
+            return versionedInt;
+
+        est = (int32)((int64)versionedInt->count * budget / size);
+        while (est > lo && VERINT_SIZE(est, layoutFlags) > TOAST_TUPLE_THRESHOLD)
+        {
+            newVerint = verint_alloc(est, est, layoutFlags);
+            verint_copy_entries(newVerint->entries, versionedInt, versionedInt->count - est, est);
+            verint_copy_prefix(VERINT_PREFIX(newVerint), versionedInt, versionedInt->count - est, est);
+            verint_copy_value_index(VERINT_VALUE_INDEX(newVerint), versionedInt, versionedInt->count - est);
+
+            size = verint_compressed_size(newVerint);
+            if (size <= (Size)budget)
+                return newVerint;
+
+            pfree(newVerint);
+            est = Min(est - 1, (int32)((int64)est * budget / size));
+        }
+    }
+
+    newVerint = verint_alloc(rawMax, lo, VERINT_FLAG_BOUNDED | layoutFlags);
+    verint_copy_entries(newVerint->entries, versionedInt, versionedInt->count - lo, lo);
+    verint_copy_prefix(VERINT_PREFIX(newVerint), versionedInt, versionedInt->count - lo, lo);
+    verint_copy_value_index(VERINT_VALUE_INDEX(newVerint), versionedInt, versionedInt->count - lo);
+
+    return newVerint;
+}
+
+/*
+ *
+ * Prepares reader over possibly toasted versioned_int. Only values
+ * stored externally and uncompressed can be sliced cheaply, anything
+ * else would have to be decompressed from its start on every slice.
+ *
+ */
+static void verint_reader_init(VerintReader *reader, Datum datum)
+{
+    struct varatt_external toast_pointer;
+    struct varlena *attr = (struct varlena *)DatumGetPointer(datum);
+
+    reader->datum = datum;
+    reader->dict = NULL;
+    reader->split = NULL;
+    reader->cold = NULL;
+    reader->coldBlock = -1;
+    reader->sliced = false;
+
+    if (VARATT_IS_EXTERNAL_ONDISK(attr))
+    {
+        VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+        reader->sliced = !VARATT_EXTERNAL_IS_COMPRESSED(toast_pointer);
+    }
+
+    if (reader->sliced)
+    {
+        reader->hdr = verint_fetch_header(datum);
+        if (VERINT_FLAGS(reader->hdr) & VERINT_FLAG_SPLIT)
+        {
+            reader->split = (VersionedIntSplit *)PG_DETOAST_DATUM_SLICE(datum, 0, VERINT_SPLIT_HDRSZ - VARHDRSZ);
+            reader->hdr = (VersionedInt *)reader->split;
+        }
+        if (!(VERINT_FLAGS(reader->hdr) & (VERINT_FLAG_DICT | VERINT_FLAG_XOR)))
+            return;
+
+        reader->sliced = false;
+    }
+
+    reader->hdr = (VersionedInt *)verint_detoast_cached(datum);
+    if (VERINT_FLAGS(reader->hdr) & VERINT_FLAG_DICT)
+    {
+        reader->dict = (VersionedIntDict *)reader->hdr;
+    }
+    else if (VERINT_FLAGS(reader->hdr) & VERINT_FLAG_XOR)
+    {
+        reader->hdr = verint_xor_decode((VersionedIntXor *)reader->hdr);
+    }
+    else if (VERINT_FLAGS(reader->hdr) & VERINT_FLAG_SPLIT)
+    {
+        reader->split = (VersionedIntSplit *)reader->hdr;
+    }
+}
+
+/*
+ *
+ * Copies n entries starting at index from into dst. Sliced readers fetch
+ * them as one slice.
+ *
+ */
+static void verint_reader_fetch(VerintReader *reader, int32 from, int32 n, VersionedIntEntry *dst)
+{
+    int32 slot, count, pos;
+
+    if (reader->dict != NULL)
+    {
+        TimestampTz *times = VERINT_DICT_TIMES(reader->dict);
+
+        for (count = 0; count < n; count++)
+        {
+            dst[count].time = times[from + count];
+            dst[count].value = verint_dict_value(reader->dict, from + count);
+        }
+        return;
+    }
+
+    while (reader->split != NULL && n > 0)
+    {
+        if (from >= VERINT_SPLIT_COLD(reader->split))
+        {
+            verint_reader_read(reader,
+                               reader->split->tail_offset +
+                                   (Size)(from - VERINT_SPLIT_COLD(reader->split)) * sizeof(VersionedIntEntry),
+                               n * sizeof(VersionedIntEntry), dst);
+            return;
+        }
+
+        pos = from + reader->split->skip;
+        if (reader->coldBlock != pos / reader->split->tail_cap)
+            verint_reader_load_block(reader, pos / reader->split->tail_cap);
+
+        slot = pos - reader->coldBlock * reader->split->tail_cap;
+        count = Min(n, reader->split->tail_cap - slot);
+        memcpy(dst, &reader->cold[slot], count * sizeof(VersionedIntEntry));
+
+        dst += count;
+        from += count;
+        n -= count;
+    }
+    if (reader->split != NULL)
+        return;
+
+    if (n > 0)
+        verint_reader_read(reader, VERINT_HDRSZ + (Size)from * sizeof(VersionedIntEntry),
+                           n * sizeof(VersionedIntEntry), dst);
+}
+
+/*
+ *
+ * Copies size bytes at offset from start of reader's datum into dst,
+ * through a slice for sliced readers.
+ *
+ */
+static void verint_reader_read(VerintReader *reader, Size offset, Size size, void *dst)
+{
+    struct varlena *slice;
+
+    if (!reader->sliced)
+    {
+        memcpy(dst, (char *)reader->hdr + offset, size);
+        return;
+    }
+
+    slice = PG_DETOAST_DATUM_SLICE(reader->datum, offset - VARHDRSZ, size);
+    memcpy(dst, VARDATA(slice), size);
+    pfree(slice);
+}
+
+/*
+ *
+ * Decompresses cold block of split versioned_int into reader's cache.
+ *
+ */
+static void verint_reader_load_block(VerintReader *reader, int32 block)
+{
+    VersionedIntSplit *split = reader->split;
+    Size rawSize = (Size)split->tail_cap * sizeof(VersionedIntEntry);
+    int32 offsets[2];
+    char *data;
+
+    if (reader->cold == NULL)
+        reader->cold = (VersionedIntEntry *)palloc(rawSize);
+
+    verint_reader_read(reader, VERINT_SPLIT_HDRSZ + (Size)block * sizeof(int32), sizeof(offsets), offsets);
+    data = (char *)palloc(offsets[1] - offsets[0]);
+    verint_reader_read(reader, VERINT_SPLIT_BLOCKS(split->nblocks) + offsets[0], offsets[1] - offsets[0], data);
+
+    if ((Size)(offsets[1] - offsets[0]) == rawSize)
+    {
+        memcpy(reader->cold, data, rawSize);
+    }
+    else if (pglz_decompress(data, offsets[1] - offsets[0], (char *)reader->cold, rawSize, true) < 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_DATA_CORRUPTED)),
+                errmsg("compressed versioned_int block is corrupt"));
+    }
+
+    pfree(data);
+    reader->coldBlock = block;
+}
+
+/*
+ *
+ * Returns number of entries whose time is less than (or, if inclusive,
+ * less than or equal to) given time.
+ *
+ */
+static int32 verint_reader_search(VerintReader *reader, TimestampTz time, bool inclusive)
+{
+    VersionedIntEntry entry;
+    int32 l = 0;
+    int32 r = reader->hdr->count;
+
+    while (l < r)
+    {
+        int32 mid = l + (r - l) / 2;
+
+        verint_reader_fetch(reader, mid, 1, &entry);
+        if (entry.time < time || (inclusive && entry.time == time))
+        {
+            l = mid + 1;
+        }
+        else
+        {
+            r = mid;
+        }
+    }
+
+    return l;
+}
+
+/*
+ *
+ * Returns right sized versioned_int holding entries with time in
+ * [from, to), or NULL if there are none. Bounds are found by binary
+ * search and entries are copied at most two runs at a time, so for
+ * sliced values only header and selected entries are read.
+ *
+ */
+static VersionedInt *verint_extract(Datum datum, TimestampTz from, TimestampTz to)
+{
+    VerintReader reader;
+    VersionedInt *newVerint;
+    int32 first, end;
+
+    verint_reader_init(&reader, datum);
+    first = verint_reader_search(&reader, from, false);
+    end = verint_reader_search(&reader, to, false);
+    if (first >= end)
+        return NULL;
+
+    newVerint = verint_alloc(end - first, end - first, 0);
+    verint_reader_fetch(&reader, first, end - first, newVerint->entries);
+
+    return newVerint;
+}
+
+/*
+ *
+ * Validates downsampling target of at least minPoints and returns
+ * entries of versioned_int argument 0 with time in tstzrange argument 2,
+ * unrolled into a contiguous array. Returns NULL if there are none.
+ *
+ */
+static VersionedInt *verint_fetch_range_arg(FunctionCallInfo fcinfo, int32 minPoints)
+{
+    TimestampTz from, to;
+
+    if (PG_GETARG_INT32(1) < minPoints)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                errmsg("number of points must be at least %d", minPoints));
+    }
+
+    if (!get_range_bounds(fcinfo, PG_GETARG_RANGE_P(2), &from, &to))
+        return NULL;
+
+    return verint_extract(PG_GETARG_DATUM(0), from, to);
+}
+
+/*
+ *
+ * Builds (times timestamptz[], vals bigint[]) result record out of n
+ * points.
+ *
+ */
+static Datum verint_points_result(FunctionCallInfo fcinfo, VersionedIntEntry *points, int32 n)
+{
+    TupleDesc tupdesc;
+    Datum *times = (Datum *)palloc((n + 1) * sizeof(Datum));
+    Datum *values = (Datum *)palloc((n + 1) * sizeof(Datum));
+    Datum result[2];
+    bool nulls[2] = {false, false};
+    int32 i;
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED)),
+                errmsg("function returning record called in context that cannot accept type record"));
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        times[i] = TimestampTzGetDatum(points[i].time);
+        values[i] = Int64GetDatum(points[i].value);
+    }
+
+    result[0] = PointerGetDatum(construct_array(times, n, TIMESTAMPTZOID, sizeof(TimestampTz),
+                                                FLOAT8PASSBYVAL, TYPALIGN_DOUBLE));
+    result[1] = PointerGetDatum(construct_array(values, n, INT8OID, sizeof(int64),
+                                                FLOAT8PASSBYVAL, TYPALIGN_DOUBLE));
+
+    return HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), result, nulls));
+}
+
+/*
+ *
+ * Returns prefix integral of entry at index i. Reader's value
+ * must carry prefix array.
+ *
+ */
+static int128 verint_reader_prefix(VerintReader *reader, int32 i)
+{
+    int128 prefix;
+
+    verint_reader_read(reader,
+                       VERINT_HDRSZ + (Size)reader->hdr->cap * sizeof(VersionedIntEntry) + (Size)i * sizeof(int128),
+                       sizeof(int128), &prefix);
+
+    return prefix;
+}
+
+/*
+ *
+ * Returns integral of history from its first entry up to given time,
+ * offset by the first entry's prefix. Integral over [from, to) is then
+ * a difference of two calls, whatever the length of range.
+ *
+ */
+static int128 verint_reader_integral_to(VerintReader *reader, TimestampTz time)
+{
+    VersionedIntEntry entry;
+    int32 k = verint_reader_search(reader, time, true) - 1;
+
+    if (k < 0)
+        return verint_reader_prefix(reader, 0);
+
+    verint_reader_fetch(reader, k, 1, &entry);
+    return verint_reader_prefix(reader, k) + (int128)entry.value * ((int128)time - entry.time);
+}
+
+/*
+ *
+ * Fetches versioned_int's current (last) entry. For sliced values only
+ * header and that one entry are read, Gorilla encoded ones keep it in
+ * their codec state. Returns false for empty history.
+ *
+ */
+static bool verint_fetch_last(Datum datum, VersionedIntEntry *entry)
+{
+    VerintReader reader;
+    VersionedIntXor *xor;
+
+    if (VERINT_FLAGS(verint_fetch_header(datum)) & VERINT_FLAG_XOR)
+    {
+        xor = (VersionedIntXor *)verint_detoast_cached(datum);
+        if (xor->count == 0)
+            return false;
+
+        entry->time = xor->state.time;
+        entry->value = (int64)xor->state.value;
+        return true;
+    }
+
+    verint_reader_init(&reader, datum);
+    if (reader.hdr->count == 0)
+        return false;
+
+    verint_reader_fetch(&reader, reader.hdr->count - 1, 1, entry);
+    return true;
+}
+
+/*
+ *
+ * Point in time lookup that, for sliced values, reads only history's
+ * tail. Entries are time ordered, so recent timestamps are answered from
+ * the last VERINT_TAIL_WINDOW entries; window moves back and doubles
+ * only while target time lies before it. Returns false if versioned_int
+ * didn't exist at given time.
+ *
+ */
+static bool verint_lookup_at(Datum datum, TimestampTz timestamp, VersionedIntEntry *entry)
+{
+    VerintReader reader;
+    VersionedIntEntry *window;
+    VersionedIntEntry *found;
+    int32 start, end, size, l, r;
+
+    verint_reader_init(&reader, datum);
+
+    if (!reader.sliced && reader.dict == NULL && reader.split == NULL)
+    {
+        found = get_versioned_ints_value_at_time(reader.hdr, timestamp);
+        if (found == NULL)
+            return false;
+
+        *entry = *found;
+        return true;
+    }
+
+    end = reader.hdr->count;
+    size = VERINT_TAIL_WINDOW;
+    window = (VersionedIntEntry *)palloc(size * sizeof(VersionedIntEntry));
+    while (end > 0)
+    {
+        start = Max(end - size, 0);
+        verint_reader_fetch(&reader, start, end - start, window);
+
+        if (window[0].time <= timestamp)
+        {
+            /* Last entry in window not after timestamp */
+            l = 0;
+            r = end - start;
+            while (l < r)
+            {
+                int32 mid = l + (r - l) / 2;
+
+                if (window[mid].time <= timestamp)
+                    l = mid + 1;
+                else
+                    r = mid;
+            }
+
+            *entry = window[l - 1];
+            pfree(window);
+            return true;
+        }
+
+        end = start;
+        size *= 2;
+        window = (VersionedIntEntry *)repalloc(window, size * sizeof(VersionedIntEntry));
+    }
+
+    pfree(window);
+    return false;
+}
+
+static pg_attribute_always_inline void accumulate_step(VerintRangeStats *stats, int64 value, TimestampTz start,
+                                                       TimestampTz end, VerintValueType type)
+{
+    if (end <= start)
+        return;
+
+    if (stats->covered == 0)
+        stats->first = value;
+
+    if (type == VERINT_FLOAT8)
+        stats->float_integral += verfloat_value(value) * (float8)(end - start);
+    else
+        stats->integral += (int128)value * ((int128)end - start);
+    stats->covered += end - start;
+    stats->min = Min(stats->min, value);
+    stats->max = Max(stats->max, value);
+    stats->last = value;
+}
+
+/*
+ *
+ * Computes VerintRangeStats of versioned_int argument 0 over tstzrange
+ * argument 1. Start of range is found by binary search and entries in
+ * range are then swept once, in batches. If caller needs only integral
+ * and covered time and value carries prefix array, no sweep is done.
+ * Returns false if there's nothing to aggregate.
+ *
+ */
+static bool get_range_stats(FunctionCallInfo fcinfo, VerintRangeStats *stats, bool integralOnly)
+{
+    return get_range_stats_internal(fcinfo, stats, integralOnly, VERINT_INT8);
+}
+
+static bool get_float8_range_stats(FunctionCallInfo fcinfo, VerintRangeStats *stats, bool integralOnly)
+{
+    return get_range_stats_internal(fcinfo, stats, integralOnly, VERINT_FLOAT8);
+}
+
+static pg_attribute_always_inline bool get_range_stats_internal(FunctionCallInfo fcinfo, VerintRangeStats *stats,
+                                                                bool integralOnly, VerintValueType type)
+{
+    VerintReader reader;
+    VersionedIntEntry *batch;
+    VersionedIntEntry prev;
+    VersionedIntEntry head;
+    TimestampTz from, to;
+    int32 first, end, n, i;
+    bool havePrev = false;
+
+    if (!get_range_bounds(fcinfo, PG_GETARG_RANGE_P(1), &from, &to))
+        return false;
+
+    if (to == DT_NOEND)
+        to = GetCurrentTransactionStartTimestamp();
+
+    memset(stats, 0, sizeof(VerintRangeStats));
+    stats->min = PG_INT64_MAX;
+    stats->max = PG_INT64_MIN;
+
+    verint_reader_init(&reader, PG_GETARG_DATUM(0));
+    if (type == VERINT_INT8 && integralOnly && (VERINT_FLAGS(reader.hdr) & VERINT_FLAG_PREFIX))
+    {
+        if (reader.hdr->count == 0)
+            return false;
+
+        verint_reader_fetch(&reader, 0, 1, &head);
+        from = Max(from, head.time);
+        if (to <= from)
+            return false;
+
+        stats->integral = verint_reader_integral_to(&reader, to) - verint_reader_integral_to(&reader, from);
+        stats->covered = to - from;
+        return true;
+    }
+
+    first = Max(verint_reader_search(&reader, from, true) - 1, 0);
+    end = verint_reader_search(&reader, to, false);
+
+    batch = (VersionedIntEntry *)palloc(Min(Max(end - first, 1), VERINT_READER_BATCH) * sizeof(VersionedIntEntry));
+    while (first < end)
+    {
+        n = Min(end - first, VERINT_READER_BATCH);
+        verint_reader_fetch(&reader, first, n, batch);
+
+        for (i = 0; i < n; i++)
+        {
+            if (havePrev)
+                accumulate_step(stats, prev.value, Max(prev.time, from), Min(batch[i].time, to), type);
+
+            prev = batch[i];
+            havePrev = true;
+        }
+
+        first += n;
+    }
+    pfree(batch);
+
+    if (havePrev)
+        accumulate_step(stats, prev.value, Max(prev.time, from), to, type);
+
+    return stats->covered > 0;
+}
+
+/*
+ *
+ * Collects steps of versioned_int argument 0 within tstzrange argument 1,
+ * reading entries in batches like get_range_stats does. Unbounded range
+ * end stands for current transaction's timestamp. Sets total to summed
+ * duration of steps. Returns NULL if there are none.
+ *
+ */
+static VerintStep *get_range_steps(FunctionCallInfo fcinfo, int32 *nsteps, int64 *total)
+{
+    VerintReader reader;
+    VersionedIntEntry *batch;
+    VersionedIntEntry prev;
+    VerintStep *steps;
+    TimestampTz from, to;
+    int32 first, end, n, i;
+    bool havePrev = false;
+
+    *nsteps = 0;
+    *total = 0;
+
+    if (!get_range_bounds(fcinfo, PG_GETARG_RANGE_P(1), &from, &to))
+        return NULL;
+
+    if (to == DT_NOEND)
+        to = GetCurrentTransactionStartTimestamp();
+
+    verint_reader_init(&reader, PG_GETARG_DATUM(0));
+    first = Max(verint_reader_search(&reader, from, true) - 1, 0);
+    end = verint_reader_search(&reader, to, false);
+    if (first >= end)
+        return NULL;
+
+    steps = (VerintStep *)palloc((end - first) * sizeof(VerintStep));
+    batch = (VersionedIntEntry *)palloc(Min(end - first, VERINT_READER_BATCH) * sizeof(VersionedIntEntry));
+    while (first < end)
+    {
+        n = Min(end - first, VERINT_READER_BATCH);
+        verint_reader_fetch(&reader, first, n, batch);
+
+        for (i = 0; i < n; i++)
+        {
+            if (havePrev)
+                add_step(steps, nsteps, total, prev.value, Max(prev.time, from), Min(batch[i].time, to));
+
+            prev = batch[i];
+            havePrev = true;
+        }
+
+        first += n;
+    }
+    pfree(batch);
+
+    add_step(steps, nsteps, total, prev.value, Max(prev.time, from), to);
+
+    if (*nsteps == 0)
+    {
+        pfree(steps);
+        return NULL;
+    }
+
+    return steps;
+}
+
+static inline void add_step(VerintStep *steps, int32 *nsteps, int64 *total, int64 value, TimestampTz start, TimestampTz end)
+{
+    if (end <= start)
+        return;
+
+    steps[*nsteps].value = value;
+    steps[*nsteps].duration = end - start;
+    *total += end - start;
+    (*nsteps)++;
+}
+
+/*
+ *
+ * Computes VerintCounterStats of versioned_int argument 0 over entries
+ * with time within tstzrange argument 1, in one batched scan. Returns
+ * false if range holds no entries.
+ *
+ */
+static bool get_counter_stats(FunctionCallInfo fcinfo, VerintCounterStats *stats)
+{
+    VerintReader reader;
+    VersionedIntEntry *batch;
+    int32 first, end, n, i;
+
+    memset(stats, 0, sizeof(VerintCounterStats));
+
+    if (!get_range_bounds(fcinfo, PG_GETARG_RANGE_P(1), &stats->from, &stats->to))
+        return false;
+
+    if (stats->to == DT_NOEND)
+        stats->to = GetCurrentTransactionStartTimestamp();
+
+    verint_reader_init(&reader, PG_GETARG_DATUM(0));
+    first = verint_reader_search(&reader, stats->from, false);
+    end = verint_reader_search(&reader, stats->to, false);
+    if (first >= end)
+        return false;
+
+    batch = (VersionedIntEntry *)palloc(Min(end - first, VERINT_READER_BATCH) * sizeof(VersionedIntEntry));
+    while (first < end)
+    {
+        n = Min(end - first, VERINT_READER_BATCH);
+        verint_reader_fetch(&reader, first, n, batch);
+
+        for (i = 0; i < n; i++)
+        {
+            if (stats->count == 0)
+            {
+                stats->first = batch[i];
+            }
+            else
+            {
+                stats->prev = stats->last;
+                stats->increase += batch[i].value < stats->last.value
+                                       ? (float8)batch[i].value
+                                       : (float8)batch[i].value - (float8)stats->last.value;
+            }
+
+            stats->last = batch[i];
+            stats->count++;
+        }
+
+        first += n;
+    }
+    pfree(batch);
+
+    if (stats->from == DT_NOBEGIN)
+        stats->from = stats->first.time;
+
+    return true;
+}
+
+/*
+ *
+ * Extends increase between first and last entry to range's edges. Gaps
+ * to an edge shorter than 1.1 average sampling interval are assumed to
+ * be covered by the series and extrapolated fully, longer ones only by
+ * half an interval. Counter is never extrapolated below zero at start.
+ *
+ */
+static float8 extrapolated_increase(VerintCounterStats *stats)
+{
+    float8 sampled = (float8)(stats->last.time - stats->first.time);
+    float8 average, threshold, toStart, toEnd, toZero;
+
+    if (sampled <= 0)
+        return stats->increase;
+
+    average = sampled / (stats->count - 1);
+    threshold = average * 1.1;
+    toStart = (float8)(stats->first.time - stats->from);
+    toEnd = (float8)(stats->to - stats->last.time);
+
+    if (stats->increase > 0 && stats->first.value >= 0)
+    {
+        toZero = sampled * ((float8)stats->first.value / stats->increase);
+        toStart = Min(toStart, toZero);
+    }
+
+    if (toStart >= threshold)
+        toStart = average / 2;
+    if (toEnd >= threshold)
+        toEnd = average / 2;
+
+    return stats->increase * ((sampled + toStart + toEnd) / sampled);
+}
+
+/*
+ *
+ * Returns tstzmultirange of times at which "v op value" held, for
+ * versioned_int argument 0. Entries are read and compared in batches.
+ *
+ */
+static MultirangeType *verint_intervals_matching(FunctionCallInfo fcinfo, VerintOp op, int64 value)
+{
+    TypeCacheEntry *typcache = range_get_typcache(fcinfo, TSTZRANGEOID);
+    VerintReader reader;
+    VersionedIntEntry *batch;
+    RangeType **ranges;
+    RangeBound lower, upper;
+    bool *matches;
+    bool inRun = false;
+    int32 first, end, n, i, nranges = 0;
+
+    verint_reader_init(&reader, PG_GETARG_DATUM(0));
+    end = reader.hdr->count;
+
+    /* Every run but the last one is closed by a non matching entry */
+    ranges = (RangeType **)palloc((end / 2 + 1) * sizeof(RangeType *));
+    batch = (VersionedIntEntry *)palloc(Min(Max(end, 1), VERINT_READER_BATCH) * sizeof(VersionedIntEntry));
+    matches = (bool *)palloc(Min(Max(end, 1), VERINT_READER_BATCH) * sizeof(bool));
+
+    lower.infinite = false;
+    lower.inclusive = true;
+    lower.lower = true;
+    upper.inclusive = false;
+    upper.lower = false;
+
+    for (first = 0; first < end; first += n)
+    {
+        n = Min(end - first, VERINT_READER_BATCH);
+        verint_reader_fetch(&reader, first, n, batch);
+        verint_match_batch(batch, n, op, value, matches);
+
+        for (i = 0; i < n; i++)
+        {
+            if (matches[i] && !inRun)
+            {
+                lower.val = TimestampTzGetDatum(batch[i].time);
+                inRun = true;
+            }
+            else if (!matches[i] && inRun)
+            {
+                upper.val = TimestampTzGetDatum(batch[i].time);
+                upper.infinite = false;
+                ranges[nranges++] = make_range(typcache, &lower, &upper, false, NULL);
+                inRun = false;
+            }
+        }
+    }
+
+    if (inRun)
+    {
+        upper.val = (Datum)0;
+        upper.infinite = true;
+        ranges[nranges++] = make_range(typcache, &lower, &upper, false, NULL);
+    }
+
+    return make_multirange(TSTZMULTIRANGEOID, typcache, nranges, ranges);
+}
+
+static VerintOp verint_parse_op(text *op)
+{
+    char *str = text_to_cstring(op);
+
+    if (strcmp(str, "<") == 0)
+        return VERINT_OP_LT;
+    if (strcmp(str, "<=") == 0)
+        return VERINT_OP_LE;
+    if (strcmp(str, "=") == 0)
+        return VERINT_OP_EQ;
+    if (strcmp(str, "<>") == 0 || strcmp(str, "!=") == 0)
+        return VERINT_OP_NE;
+    if (strcmp(str, ">=") == 0)
+        return VERINT_OP_GE;
+    if (strcmp(str, ">") == 0)
+        return VERINT_OP_GT;
+
+    ereport(ERROR,
+            (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+            errmsg("unknown comparison operator \"%s\"", str),
+            errhint("Valid operators are <, <=, =, <>, >= and >."));
+    return VERINT_OP_EQ; /* keep compiler quiet */
+}
+
+/*
+ *
+ * Evaluates "entry.value op value" for a batch of entries. Operator is
+ * dispatched once per batch, leaving branch free loops that compiler
+ * can vectorize.
+ *
+ */
+static void verint_match_batch(const VersionedIntEntry *batch, int32 n, VerintOp op, int64 value, bool *matches)
+{
+    int32 i;
+
+    switch (op)
+    {
+    case VERINT_OP_LT:
+        for (i = 0; i < n; i++)
+            matches[i] = batch[i].value < value;
+        break;
+    case VERINT_OP_LE:
+        for (i = 0; i < n; i++)
+            matches[i] = batch[i].value <= value;
+        break;
+    case VERINT_OP_EQ:
+        for (i = 0; i < n; i++)
+            matches[i] = batch[i].value == value;
+        break;
+    case VERINT_OP_NE:
+        for (i = 0; i < n; i++)
+            matches[i] = batch[i].value != value;
+        break;
+    case VERINT_OP_GE:
+        for (i = 0; i < n; i++)
+            matches[i] = batch[i].value >= value;
+        break;
+    case VERINT_OP_GT:
+        for (i = 0; i < n; i++)
+            matches[i] = batch[i].value > value;
+        break;
+    }
+}
+
+static int verint_step_cmp(const void *a, const void *b)
+{
+    int64 av = ((const VerintStep *)a)->value;
+    int64 bv = ((const VerintStep *)b)->value;
+
+    if (av < bv)
+        return -1;
+    if (av > bv)
+        return 1;
+
+    return 0;
+}
+
+static int verint_probe_cmp(const void *a, const void *b)
+{
+    TimestampTz at = ((const VerintProbe *)a)->time;
+    TimestampTz bt = ((const VerintProbe *)b)->time;
+
+    if (at < bt)
+        return -1;
+    if (at > bt)
+        return 1;
+
+    return 0;
+}
+
+static int verint_threshold_cmp(const void *a, const void *b)
+{
+    int64 aw = ((const VerintThreshold *)a)->weight;
+    int64 bw = ((const VerintThreshold *)b)->weight;
+
+    if (aw < bw)
+        return -1;
+    if (aw > bw)
+        return 1;
+
+    return 0;
+}
+
+/*
+ *
+ * Turns tstzrange into half open interval [from, to), with infinite
+ * bounds mapped to -infinity and infinity. Returns false for empty range.
+ *
+ */
+static bool get_range_bounds(FunctionCallInfo fcinfo, RangeType *range, TimestampTz *from, TimestampTz *to)
+{
+    TypeCacheEntry *typcache = range_get_typcache(fcinfo, RangeTypeGetOid(range));
+    RangeBound lower, upper;
+    bool empty;
+
+    range_deserialize(typcache, range, &lower, &upper, &empty);
+    if (empty)
+        return false;
+
+    if (lower.infinite)
+    {
+        *from = DT_NOBEGIN;
+    }
+    else
+    {
+        *from = DatumGetTimestampTz(lower.val);
+        if (!lower.inclusive && *from < DT_NOEND)
+            *from += 1;
+    }
+
+    if (upper.infinite)
+    {
+        *to = DT_NOEND;
+    }
+    else
+    {
+        *to = DatumGetTimestampTz(upper.val);
+        if (upper.inclusive && *to < DT_NOEND)
+            *to += 1;
+    }
+
+    return *from < *to;
+}
+
+static int64 floor_div(int64 a, int64 b)
+{
+    int64 q = a / b;
+
+    if ((a % b != 0) && ((a < 0) != (b < 0)))
+        q -= 1;
+
+    return q;
+}
+
+/*
+ *
+ * Compacts regions of history older than policy's tiers into buckets
+ * of tier's width. From each bucket entries holding its minimum and
+ * maximum value are kept along with its last entry, so envelope and
+ * value at bucket's end survive. Buckets are aligned to epoch, which
+ * makes compaction idempotent. Surviving entries are counted before
+ * anything is allocated, so history that needs no compaction, which is
+ * the steady state of a 'T' column, is returned as is after one scan.
+ *
+ */
+static VersionedInt *enforce_Tier_retention(VersionedInt *versionedInt, VerintTierPolicy *policy)
+{
+    TimestampTz now = GetCurrentTimestamp();
+    VersionedInt *newVerint;
+    int32 nkept;
+
+    if (versionedInt->count == 0 ||
+        verint_entry(versionedInt, 0)->time >= now - policy->tiers[0].older_than)
+    {
+        return versionedInt;
+    }
+
+    nkept = verint_tier_compact(versionedInt, policy, now, NULL);
+    if (nkept == versionedInt->count)
+    {
+        return versionedInt;
+    }
+
+    newVerint = verint_alloc(nkept, nkept, VERINT_FLAGS(versionedInt) & VERINT_LAYOUT_MASK);
+    verint_tier_compact(versionedInt, policy, now, newVerint->entries);
+    verint_fill_prefix(newVerint, 0);
+    verint_fill_value_index(newVerint);
+
+    return newVerint;
+}
+
+/*
+ *
+ * Single pass of tier compaction. Returns number of entries that survive
+ * it, writing them to kept unless it is NULL.
+ *
+ */
+static int32 verint_tier_compact(VersionedInt *versionedInt, VerintTierPolicy *policy, TimestampTz now,
+                                 VersionedIntEntry *kept)
+{
+    VersionedIntEntry *entry;
+    int32 nkept = 0;
+    int32 i, j, tier, minIdx, maxIdx;
+    int64 bucket;
+
+    i = 0;
+    while (i < versionedInt->count)
+    {
+        entry = verint_entry(versionedInt, i);
+
+        for (tier = policy->ntiers - 1; tier >= 0; tier--)
+        {
+            if (entry->time < now - policy->tiers[tier].older_than)
+                break;
+        }
+
+        /* Entries are sorted, so everything from here on is at full resolution */
+        if (tier < 0)
+        {
+            if (kept != NULL)
+                verint_copy_entries(&kept[nkept], versionedInt, i, versionedInt->count - i);
+            nkept += versionedInt->count - i;
+            break;
+        }
+
+        bucket = floor_div(entry->time, policy->tiers[tier].bucket);
+        minIdx = maxIdx = j = i;
+        while (j + 1 < versionedInt->count)
+        {
+            VersionedIntEntry *next = verint_entry(versionedInt, j + 1);
+
+            if (next->time >= now - policy->tiers[tier].older_than ||
+                floor_div(next->time, policy->tiers[tier].bucket) != bucket)
+                break;
+
+            j++;
+            if (next->value < verint_entry(versionedInt, minIdx)->value)
+                minIdx = j;
+            if (next->value > verint_entry(versionedInt, maxIdx)->value)
+                maxIdx = j;
+        }
+
+        if (Min(minIdx, maxIdx) < j)
+        {
+            if (kept != NULL)
+                kept[nkept] = *verint_entry(versionedInt, Min(minIdx, maxIdx));
+            nkept++;
+        }
+        if (minIdx != maxIdx && Max(minIdx, maxIdx) < j)
+        {
+            if (kept != NULL)
+                kept[nkept] = *verint_entry(versionedInt, Max(minIdx, maxIdx));
+            nkept++;
+        }
+        if (kept != NULL)
+            kept[nkept] = *verint_entry(versionedInt, j);
+        nkept++;
+
+        i = j + 1;
+    }
+
+    return nkept;
+}
+
+/*
+ *
+ * Returns tiers of retention policy declared in versioned_int_tier table.
+ * Table lives in extension's schema, which is looked up through calling
+ * function's namespace since extension is relocatable. Policies are read
+ * once per transaction, or again after versioned_int_tier_reset trigger
+ * saw the table change.
+ *
+ */
+static VerintTierPolicy *get_tier_policy(FunctionCallInfo fcinfo, int32 policy)
+{
+    VerintTierPolicy *result;
+    MemoryContext oldContext;
+    char *query;
+    Oid argtypes[1] = {INT4OID};
+    Datum args[1];
+    bool isNull;
+    uint64 i;
+    int ret;
+
+    for (result = tier_policies; result != NULL; result = result->next)
+    {
+        if (result->policy == policy)
+            return result;
+    }
+
+    query = psprintf("SELECT (extract(epoch FROM older_than) * 1000000)::int8, "
+                     "(extract(epoch FROM bucket) * 1000000)::int8 "
+                     "FROM %s.versioned_int_tier WHERE policy = $1 ORDER BY older_than",
+                     quote_identifier(get_namespace_name(get_func_namespace(fcinfo->flinfo->fn_oid))));
+    args[0] = Int32GetDatum(policy);
+
+    if (SPI_connect() != SPI_OK_CONNECT)
+        elog(ERROR, "SPI_connect failed");
+
+    ret = SPI_execute_with_args(query, 1, argtypes, args, NULL, true, 0);
+    if (ret != SPI_OK_SELECT)
+        elog(ERROR, "SPI_execute_with_args failed: %s", SPI_result_code_string(ret));
+
+    if (SPI_processed == 0)
+        ereport(ERROR,
+                (errcode(ERRCODE_UNDEFINED_OBJECT),
+                 errmsg("retention policy %d is not defined in versioned_int_tier", policy)));
+
+    oldContext = MemoryContextSwitchTo(TopTransactionContext);
+    result = (VerintTierPolicy *)palloc(offsetof(VerintTierPolicy, tiers) + SPI_processed * sizeof(VerintTier));
+    MemoryContextSwitchTo(oldContext);
+
+    result->policy = policy;
+    result->ntiers = (int32)SPI_processed;
+    for (i = 0; i < SPI_processed; i++)
+    {
+        result->tiers[i].older_than = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 1, &isNull));
+        result->tiers[i].bucket = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[i], SPI_tuptable->tupdesc, 2, &isNull));
+
+        if (result->tiers[i].older_than < 0 || result->tiers[i].bucket <= 0)
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                     errmsg("retention policy %d has tier with negative age or non positive bucket", policy)));
+    }
+
+    SPI_finish();
+
+    result->next = tier_policies;
+    tier_policies = result;
+
+    return result;
+}
+
+/*
+ *
+ * Helper function that given versioned_int and timestamp returns
+ * versioned_ints value at that time or null if it didn't exist at
+ * said time.
+ *
+ */
+static VersionedIntEntry *get_versioned_ints_value_at_time(VersionedInt *versionedInt, TimestampTz timestamp)
+{
+    VersionedIntEntry *entry;
+    int32 l = 0;
+    int32 r = versionedInt->count - 1;
+    int32 mid;
+
+    if (versionedInt->count == 0)
+    {
+        return NULL;
+    }
+    if (timestamp >= verint_last(versionedInt)->time)
+    {
+        return verint_last(versionedInt);
+    }
+
+    while (l <= r)
+    {
+        mid = l + (r - l) / 2;
+        entry = verint_entry(versionedInt, mid);
+
+        if (entry->time == timestamp)
+        {
+            return entry;
+        }
+        else if (entry->time < timestamp)
+        {
+            l = mid + 1;
+        }
+        else
+        {
+            r = mid - 1;
+        }
+    }
+
+    if (r >= 0)
+    {
+        return verint_entry(versionedInt, r);
+    }
+
+    return NULL;
+}
+
+/*
+ *
+ * Allocates zeroed versioned_int with room for cap entries.
+ *
+ */
+static VersionedInt *verint_alloc(int32 cap, int32 count, int32 flags)
+{
+    VersionedInt *versionedInt = (VersionedInt *)palloc0(VERINT_SIZE(cap, flags));
+
+    SET_VARSIZE(versionedInt, VERINT_SIZE(cap, flags));
+    versionedInt->cap = cap;
+    versionedInt->count = count;
+    versionedInt->flags = flags;
+
+    return versionedInt;
+}
+
+/*
+ *
+ * Copies prefix integrals of n entries starting at index from into dst.
+ * Does nothing if src carries no prefix array.
+ *
+ */
+static void verint_copy_prefix(int128 *dst, VersionedInt *src, int32 from, int32 n)
+{
+    if (n <= 0 || !(VERINT_FLAGS(src) & VERINT_FLAG_PREFIX))
+        return;
+
+    memcpy(dst, &VERINT_PREFIX(src)[from], n * sizeof(int128));
+}
+
+/*
+ *
+ * (Re)computes prefix integrals of entries from index from to
+ * the end, out of the prefix of entry before it. Appending an entry
+ * needs only its own prefix computed, which is O(1).
+ *
+ */
+static void verint_fill_prefix(VersionedInt *versionedInt, int32 from)
+{
+    VersionedIntEntry *prev;
+    VersionedIntEntry *entry;
+    int32 i;
+
+    if (!(VERINT_FLAGS(versionedInt) & VERINT_FLAG_PREFIX))
+        return;
+
+    for (i = Max(from, 0); i < versionedInt->count; i++)
+    {
+        if (i == 0)
+        {
+            *verint_prefix(versionedInt, 0) = 0;
+            continue;
+        }
+
+        prev = verint_entry(versionedInt, i - 1);
+        entry = verint_entry(versionedInt, i);
+        *verint_prefix(versionedInt, i) = *verint_prefix(versionedInt, i - 1) +
+                                          (int128)prev->value * ((int128)entry->time - prev->time);
+    }
+}
+
+/*
+ *
+ * Copies value index of src into dst, leaving out entries among first
+ * drop ones and shifting the rest to their indexes after drop.
+ * dst may be src's own index. Does nothing if src carries no index.
+ *
+ */
+static void verint_copy_value_index(int32 *dst, VersionedInt *src, int32 drop)
+{
+    int32 *index;
+    int32 i, n = 0;
+
+    if (!(VERINT_FLAGS(src) & VERINT_FLAG_VALUE_INDEX))
+        return;
+
+    index = VERINT_VALUE_INDEX(src);
+    for (i = 0; i < src->count; i++)
+    {
+        if (index[i] >= drop)
+            dst[n++] = index[i] - drop;
+    }
+}
+
+/*
+ *
+ * Adds versioned_int's last entry to value index that covers all entries
+ * before it. Being the latest one, it goes after entries of equal value.
+ *
+ */
+static void verint_append_value_index(VersionedInt *versionedInt)
+{
+    int32 *index;
+    int64 value;
+    int32 last, l, r;
+
+    if (!(VERINT_FLAGS(versionedInt) & VERINT_FLAG_VALUE_INDEX))
+        return;
+
+    index = VERINT_VALUE_INDEX(versionedInt);
+    last = versionedInt->count - 1;
+    value = verint_entry(versionedInt, last)->value;
+    l = 0;
+    r = last;
+    while (l < r)
+    {
+        int32 mid = l + (r - l) / 2;
+
+        if (verint_entry(versionedInt, index[mid])->value <= value)
+            l = mid + 1;
+        else
+            r = mid;
+    }
+
+    memmove(&index[l + 1], &index[l], (last - l) * sizeof(int32));
+    index[l] = last;
+}
+
+/*
+ *
+ * Builds value index from scratch, for changes other than an append.
+ *
+ */
+static void verint_fill_value_index(VersionedInt *versionedInt)
+{
+    int32 *index;
+    int32 i;
+
+    if (!(VERINT_FLAGS(versionedInt) & VERINT_FLAG_VALUE_INDEX))
+        return;
+
+    index = VERINT_VALUE_INDEX(versionedInt);
+    for (i = 0; i < versionedInt->count; i++)
+    {
+        index[i] = i;
+    }
+
+    qsort_arg(index, versionedInt->count, sizeof(int32), verint_value_index_cmp, versionedInt);
+}
+
+static int verint_value_index_cmp(const void *a, const void *b, void *arg)
+{
+    VersionedInt *versionedInt = (VersionedInt *)arg;
+    VersionedIntEntry *ea = verint_entry(versionedInt, *(const int32 *)a);
+    VersionedIntEntry *eb = verint_entry(versionedInt, *(const int32 *)b);
+
+    if (ea->value != eb->value)
+        return ea->value < eb->value ? -1 : 1;
+    if (ea->time != eb->time)
+        return ea->time < eb->time ? -1 : 1;
+
+    return *(const int32 *)a - *(const int32 *)b;
+}
+
+/*
+ *
+ * Returns copy of versioned_int with given layout flags. Side arrays are
+ * built as needed.
+ *
+ */
+static VersionedInt *verint_relayout(VersionedInt *versionedInt, int32 flags)
+{
+    VersionedInt *newVerint = verint_alloc(versionedInt->cap, versionedInt->count, flags);
+
+    verint_copy_entries(newVerint->entries, versionedInt, 0, versionedInt->count);
+    if (flags & VERINT_FLAG_PREFIX)
+    {
+        verint_fill_prefix(newVerint, 0);
+    }
+    if (flags & VERINT_FLAG_VALUE_INDEX)
+    {
+        verint_fill_value_index(newVerint);
+    }
+
+    return newVerint;
+}
+
+/*
+ *
+ * Returns versioned_int whose header fields (count, cap, flags)
+ * can be read, fetching only header's bytes if datum is toasted.
+ * Entries of returned value must not be accessed.
+ *
+ */
+static VersionedInt *verint_fetch_header(Datum datum)
+{
+    if (!VARATT_IS_EXTENDED(DatumGetPointer(datum)))
+    {
+        return (VersionedInt *)DatumGetPointer(datum);
+    }
+
+    return (VersionedInt *)PG_DETOAST_DATUM_SLICE(datum, 0, VERINT_HDRSZ - VARHDRSZ);
+}
+
+/*
+ *
+ * Detoasts versioned_int, decoding it if it's dictionary encoded, Gorilla
+ * encoded or split, so entries can be accessed directly. Plain values may
+ * be returned from detoast cache, so like verint_detoast_cached's result
+ * they must not be modified or kept past the current function call.
+ *
+ */
+static VersionedInt *verint_detoast(Datum datum)
+{
+    VersionedInt *versionedInt = (VersionedInt *)verint_detoast_cached(datum);
+
+    VerintReader reader;
+    VersionedInt *plain;
+
+    if (VERINT_FLAGS(versionedInt) & VERINT_FLAG_DICT)
+        return verint_decode((VersionedIntDict *)versionedInt);
+
+    if (VERINT_FLAGS(versionedInt) & VERINT_FLAG_XOR)
+        return verint_xor_decode((VersionedIntXor *)versionedInt);
+
+    if (VERINT_FLAGS(versionedInt) & VERINT_FLAG_SPLIT)
+    {
+        verint_reader_init(&reader, PointerGetDatum(versionedInt));
+        plain = verint_alloc(versionedInt->count, versionedInt->count, 0);
+        verint_reader_fetch(&reader, 0, versionedInt->count, plain->entries);
+        return plain;
+    }
+
+    return versionedInt;
+}
+
+/*
+ *
+ * PG_DETOAST_DATUM that keeps values stored out of line in backend local
+ * LRU cache of up to versioned_int.detoast_cache_size kB, so that
+ * evaluating the same history several times in a query decompresses it
+ * only once. Returned value must not be modified or freed, and must not
+ * be kept past the current function call: a later call may evict it into
+ * whatever memory context is current then, which may be reset before
+ * caller is done with it.
+ *
+ */
+static struct varlena *verint_detoast_cached(Datum datum)
+{
+    struct varlena *attr = (struct varlena *)DatumGetPointer(datum);
+    struct varatt_external toast_pointer;
+    VerintCacheKey key;
+    VerintCacheEntry *entry;
+    MemoryContext context, old;
+    struct varlena *value;
+    Size budget = (Size)detoast_cache_size * 1024;
+    HASHCTL ctl;
+    bool found;
+
+    if (!VARATT_IS_EXTERNAL_ONDISK(attr))
+        return PG_DETOAST_DATUM(datum);
+
+    if (detoast_cache == NULL)
+    {
+        detoast_cache_context = AllocSetContextCreate(TopMemoryContext, "versioned_int detoast cache",
+                                                      ALLOCSET_DEFAULT_SIZES);
+        ctl.keysize = sizeof(VerintCacheKey);
+        ctl.entrysize = sizeof(VerintCacheEntry);
+        ctl.hcxt = detoast_cache_context;
+        detoast_cache = hash_create("versioned_int detoast cache", 64, &ctl,
+                                    HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+        dlist_init(&detoast_cache_lru);
+    }
+
+    /* Cache may have been shrunk since last call */
+    verint_cache_evict(budget);
+
+    VARATT_EXTERNAL_GET_POINTER(toast_pointer, attr);
+    memset(&key, 0, sizeof(key));
+    key.toastrelid = toast_pointer.va_toastrelid;
+    key.valueid = toast_pointer.va_valueid;
+
+    entry = (VerintCacheEntry *)hash_search(detoast_cache, &key, HASH_FIND, NULL);
+    if (entry != NULL)
+    {
+        detoast_cache_hits++;
+        dlist_move_head(&detoast_cache_lru, &entry->lru);
+        return entry->value;
+    }
+
+    detoast_cache_misses++;
+    if ((Size)toast_pointer.va_rawsize > budget)
+        return PG_DETOAST_DATUM(datum);
+
+    /* Detoasted under current context first, so an error doesn't leak it */
+    context = AllocSetContextCreate(CurrentMemoryContext, "versioned_int detoast cache entry",
+                                    ALLOCSET_SMALL_SIZES);
+    old = MemoryContextSwitchTo(context);
+    value = PG_DETOAST_DATUM(datum);
+    MemoryContextSwitchTo(old);
+
+    verint_cache_evict(budget - VARSIZE(value));
+    MemoryContextSetParent(context, detoast_cache_context);
+
+    entry = (VerintCacheEntry *)hash_search(detoast_cache, &key, HASH_ENTER, &found);
+    entry->context = context;
+    entry->value = value;
+    entry->size = VARSIZE(value);
+    dlist_push_head(&detoast_cache_lru, &entry->lru);
+    detoast_cache_bytes += entry->size;
+
+    return value;
+}
+
+/*
+ *
+ * Evicts least recently used entries until cache holds at most budget
+ * bytes. Evicted values may still be referenced by caller, so their
+ * contexts are moved under current memory context instead of deleted.
+ *
+ */
+static void verint_cache_evict(Size budget)
+{
+    VerintCacheEntry *entry;
+
+    while (detoast_cache_bytes > budget && !dlist_is_empty(&detoast_cache_lru))
+    {
+        entry = dlist_container(VerintCacheEntry, lru, dlist_tail_node(&detoast_cache_lru));
+        dlist_delete(&entry->lru);
+        MemoryContextSetParent(entry->context, CurrentMemoryContext);
+        detoast_cache_bytes -= entry->size;
+        hash_search(detoast_cache, &entry->key, HASH_REMOVE, NULL);
+    }
+}
+
+/*
+ *
+ * Drops the whole detoast cache, together with every value it holds.
+ *
+ */
+static void verint_cache_reset(void)
+{
+    if (detoast_cache == NULL)
+        return;
+
+    MemoryContextDelete(detoast_cache_context);
+    detoast_cache_context = NULL;
+    detoast_cache = NULL;
+    detoast_cache_bytes = 0;
+}
+
+/*
+ *
+ * versioned_int_detoast_cache_stats() reports hits and misses of this
+ * backend's detoast cache, with number and total size of cached values.
+ *
+ */
+Datum versioned_int_detoast_cache_stats(PG_FUNCTION_ARGS)
+{
+    TupleDesc tupdesc;
+    Datum result[4];
+    bool nulls[4] = {false, false, false, false};
+
+    if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED)),
+                errmsg("function returning record called in context that cannot accept type record"));
+    }
+
+    result[0] = Int64GetDatum(detoast_cache_hits);
+    result[1] = Int64GetDatum(detoast_cache_misses);
+    result[2] = Int64GetDatum(detoast_cache == NULL ? 0 : hash_get_num_entries(detoast_cache));
+    result[3] = Int64GetDatum((int64)detoast_cache_bytes);
+
+    PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), result, nulls)));
+}
+
+/*
+ *
+ * Returns plain versioned_int with entries of dictionary encoded one.
+ * Codes are unpacked a byte at a time with fixed shifts, in a loop
+ * simple enough for compiler to vectorize.
+ *
+ */
+static VersionedInt *verint_decode(VersionedIntDict *dict)
+{
+    VersionedInt *versionedInt = verint_alloc(dict->cap, dict->count, VERINT_FLAGS(dict) & ~VERINT_FLAG_DICT);
+    TimestampTz *times = VERINT_DICT_TIMES(dict);
+    uint8 *codes = VERINT_DICT_CODES(dict);
+    int32 perByte = 8 / dict->bits;
+    int32 mask = (1 << dict->bits) - 1;
+    int32 i;
+
+    for (i = 0; i < dict->count; i++)
+    {
+        versionedInt->entries[i].time = times[i];
+        versionedInt->entries[i].value = dict->data[(codes[i / perByte] >> ((i % perByte) * dict->bits)) & mask];
+    }
+
+    return versionedInt;
+}
+
+/*
+ *
+ * Returns dictionary encoded copy of versioned_int if it holds at most
+ * VERINT_DICT_MAX distinct values, versioned_int itself otherwise. Short
+ * histories and ones carrying side arrays are never encoded. Called on
+ * values about to be stored.
+ *
+ */
+static VersionedInt *verint_maybe_encode(VersionedInt *versionedInt)
+{
+    VersionedIntDict *dict;
+    VersionedIntEntry *entry;
+    int64 values[VERINT_DICT_MAX];
+    uint8 *codes;
+    int32 ndict = 0, bits, perByte, code, i;
+    Size size;
+
+    if (versionedInt->count < VERINT_DICT_MIN_COUNT ||
+        (VERINT_FLAGS(versionedInt) & (VERINT_LAYOUT_MASK | VERINT_FLAG_SPLIT)))
+        return versionedInt;
+
+    for (i = 0; i < versionedInt->count; i++)
+    {
+        entry = verint_entry(versionedInt, i);
+        for (code = 0; code < ndict && values[code] != entry->value; code++)
+            ;
+        if (code == ndict)
+        {
+            if (ndict == VERINT_DICT_MAX)
+                return versionedInt;
+
+            values[ndict++] = entry->value;
+        }
+    }
+
+    bits = ndict <= 2 ? 1 : ndict <= 4 ? 2 : 4;
+    perByte = 8 / bits;
+    size = VERINT_DICT_SIZE(ndict, versionedInt->count, bits);
+
+    dict = (VersionedIntDict *)palloc0(size);
+    SET_VARSIZE(dict, size);
+    dict->count = versionedInt->count;
+    dict->cap = versionedInt->cap;
+    dict->ndict = ndict;
+    dict->bits = bits;
+    dict->flags = VERINT_FLAGS(versionedInt) | VERINT_FLAG_DICT;
+    memcpy(dict->data, values, ndict * sizeof(int64));
+
+    codes = VERINT_DICT_CODES(dict);
+    for (i = 0; i < versionedInt->count; i++)
+    {
+        entry = verint_entry(versionedInt, i);
+        for (code = 0; values[code] != entry->value; code++)
+            ;
+
+        VERINT_DICT_TIMES(dict)[i] = entry->time;
+        codes[i / perByte] |= (uint8)(code << ((i % perByte) * bits));
+    }
+
+    return (VersionedInt *)dict;
+}
+
+/*
+ *
+ * Returns tail capacity of split versioned_int, or 0 if it isn't split.
+ * Reads only header of toasted values.
+ *
+ */
+static int32 verint_split_tail_cap(Datum datum)
+{
+    VersionedInt *hdr = verint_fetch_header(datum);
+
+    if (!(VERINT_FLAGS(hdr) & VERINT_FLAG_SPLIT))
+        return 0;
+
+    if (VARATT_IS_EXTENDED(DatumGetPointer(datum)))
+        hdr = (VersionedInt *)PG_DETOAST_DATUM_SLICE(datum, 0, VERINT_SPLIT_HDRSZ - VARHDRSZ);
+
+    return ((VersionedIntSplit *)hdr)->tail_cap;
+}
+
+/*
+ *
+ * Returns split form of plain versioned_int, with all but its newest
+ * 1 to tailCap entries sealed into blocks. Side arrays have no place in
+ * blocks, so value carrying them is rejected; bounded flag is dropped,
+ * as 'N' retention trims split value by skipping into its oldest block.
+ *
+ */
+static VersionedInt *verint_split(VersionedInt *versionedInt, int32 tailCap)
+{
+    VersionedIntSplit *split;
+    VersionedIntEntry *entries;
+    int32 *offsets;
+    char *blocks;
+    int32 nblocks = versionedInt->count > 0 ? (versionedInt->count - 1) / tailCap : 0;
+    int32 k;
+
+    if (VERINT_FLAGS(versionedInt) & VERINT_LAYOUT_MASK)
+    {
+        verint_split_layout_error();
+    }
+
+    entries = (VersionedIntEntry *)palloc(Max(versionedInt->count, 1) * sizeof(VersionedIntEntry));
+    verint_copy_entries(entries, versionedInt, 0, versionedInt->count);
+
+    offsets = (int32 *)palloc((nblocks + 1) * sizeof(int32));
+    blocks = (char *)palloc(Max((Size)nblocks * PGLZ_MAX_OUTPUT(tailCap * sizeof(VersionedIntEntry)), 1));
+    offsets[0] = 0;
+    for (k = 0; k < nblocks; k++)
+    {
+        offsets[k + 1] = offsets[k] + verint_compress_block(&entries[k * tailCap], tailCap, blocks + offsets[k]);
+    }
+
+    split = verint_split_assemble(tailCap, nblocks, 0, offsets, blocks, &entries[nblocks * tailCap],
+                                  versionedInt->count - nblocks * tailCap);
+    pfree(entries);
+    pfree(offsets);
+    pfree(blocks);
+
+    return (VersionedInt *)split;
+}
+
+/*
+ *
+ * Appends entry to split versioned_int. Cold blocks are copied as they
+ * are; a full tail is first sealed into a new block.
+ *
+ */
+static VersionedInt *verint_split_append(VersionedIntSplit *split, int64 value, TimestampTz time)
+{
+    VersionedIntSplit *newSplit;
+    VersionedIntEntry entry;
+    int32 *offsets;
+    char *blocks;
+    int32 ntail = split->count - VERINT_SPLIT_COLD(split);
+
+    entry.value = value;
+    entry.time = time;
+
+    if (ntail < split->tail_cap)
+    {
+        newSplit = (VersionedIntSplit *)palloc(VARSIZE(split) + sizeof(VersionedIntEntry));
+        memcpy(newSplit, split, VARSIZE(split));
+        SET_VARSIZE(newSplit, VARSIZE(split) + sizeof(VersionedIntEntry));
+        VERINT_SPLIT_TAIL(newSplit)[ntail] = entry;
+        newSplit->count++;
+        newSplit->cap++;
+
+        return (VersionedInt *)newSplit;
+    }
+
+    offsets = (int32 *)palloc((split->nblocks + 2) * sizeof(int32));
+    memcpy(offsets, split->offsets, (split->nblocks + 1) * sizeof(int32));
+    blocks = (char *)palloc(offsets[split->nblocks] + PGLZ_MAX_OUTPUT(split->tail_cap * sizeof(VersionedIntEntry)));
+    memcpy(blocks, (char *)split + VERINT_SPLIT_BLOCKS(split->nblocks), offsets[split->nblocks]);
+    offsets[split->nblocks + 1] = offsets[split->nblocks] +
+                                  verint_compress_block(VERINT_SPLIT_TAIL(split), split->tail_cap,
+                                                        blocks + offsets[split->nblocks]);
+
+    newSplit = verint_split_assemble(split->tail_cap, split->nblocks + 1, split->skip, offsets, blocks, &entry, 1);
+    pfree(offsets);
+    pfree(blocks);
+
+    return (VersionedInt *)newSplit;
+}
+
+/*
+ *
+ * Trims split versioned_int to its newest keep entries without decoding
+ * any block. Cold blocks that fall out whole are dropped, oldest
+ * remaining one is only skipped into, and once no cold block is left
+ * tail itself is trimmed.
+ *
+ */
+static VersionedInt *verint_split_trim(VersionedIntSplit *split, int32 keep)
+{
+    VersionedIntSplit *newSplit;
+    int32 *offsets;
+    int32 pos, drop, skip;
+    int32 ntail = split->count - VERINT_SPLIT_COLD(split);
+    int32 k;
+
+    if (split->count <= keep)
+        return (VersionedInt *)split;
+
+    pos = split->skip + (split->count - keep);
+    drop = Min(split->nblocks, pos / split->tail_cap);
+    if (drop == split->nblocks)
+    {
+        ntail = keep;
+        skip = 0;
+    }
+    else
+    {
+        skip = pos - drop * split->tail_cap;
+    }
+
+    offsets = (int32 *)palloc((split->nblocks - drop + 1) * sizeof(int32));
+    for (k = drop; k <= split->nblocks; k++)
+    {
+        offsets[k - drop] = split->offsets[k] - split->offsets[drop];
+    }
+
+    newSplit = verint_split_assemble(split->tail_cap, split->nblocks - drop, skip, offsets,
+                                     (char *)split + VERINT_SPLIT_BLOCKS(split->nblocks) + split->offsets[drop],
+                                     VERINT_SPLIT_TAIL(split) + (split->count - VERINT_SPLIT_COLD(split) - ntail),
+                                     ntail);
+    pfree(offsets);
+
+    return (VersionedInt *)newSplit;
+}
+
+/*
+ *
+ * Drops oldest whole cold blocks of split versioned_int until it fits
+ * into budget bytes, then trims tail once no block is left. Sizes come
+ * from offsets array, so no block is decoded.
+ *
+ */
+static VersionedInt *verint_split_fit(VersionedIntSplit *split, int32 budget)
+{
+    int32 ntail = split->count - VERINT_SPLIT_COLD(split);
+    int32 drop;
+    Size size;
+
+    if (VARSIZE(split) <= (Size)budget)
+        return (VersionedInt *)split;
+
+    for (drop = 1; drop < split->nblocks; drop++)
+    {
+        size = MAXALIGN(VERINT_SPLIT_BLOCKS(split->nblocks - drop) + split->offsets[split->nblocks] -
+                        split->offsets[drop]) +
+               (Size)ntail * sizeof(VersionedIntEntry);
+        if (size <= (Size)budget)
+            return verint_split_trim(split, split->count - (drop * split->tail_cap - split->skip));
+    }
+
+    size = MAXALIGN(VERINT_SPLIT_BLOCKS(0));
+    if ((Size)budget <= size)
+        return verint_split_trim(split, 0);
+
+    return verint_split_trim(split, Min(ntail, (int32)(((Size)budget - size) / sizeof(VersionedIntEntry))));
+}
+
+static void verint_split_layout_error(void)
+{
+    ereport(ERROR,
+            (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+             errmsg("split versioned_int cannot carry prefix or value index"),
+             errhint("Turn them off with versioned_int_set_prefix and versioned_int_set_value_index before splitting.")));
+}
+
+static VersionedIntSplit *verint_split_assemble(int32 tailCap, int32 nblocks, int32 skip, const int32 *offsets,
+                                                const char *blocks, const VersionedIntEntry *tail, int32 ntail)
+{
+    VersionedIntSplit *split;
+    Size tailOffset = MAXALIGN(VERINT_SPLIT_BLOCKS(nblocks) + offsets[nblocks]);
+    Size size = tailOffset + (Size)ntail * sizeof(VersionedIntEntry);
+
+    if (size >= (Size)MAX_VERSIONED_INT_SIZE)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_OUT_OF_MEMORY)),
+                errmsg("Extending column would push it pass the size of 512MB. Aborting"));
+    }
+
+    split = (VersionedIntSplit *)palloc0(size);
+    SET_VARSIZE(split, size);
+    split->count = nblocks * tailCap - skip + ntail;
+    split->cap = split->count;
+    split->flags = VERINT_FLAG_SPLIT;
+    split->tail_cap = tailCap;
+    split->tail_offset = (int32)tailOffset;
+    split->nblocks = nblocks;
+    split->skip = skip;
+    memcpy(split->offsets, offsets, (nblocks + 1) * sizeof(int32));
+    memcpy((char *)split + VERINT_SPLIT_BLOCKS(nblocks), blocks, offsets[nblocks]);
+    memcpy(VERINT_SPLIT_TAIL(split), tail, ntail * sizeof(VersionedIntEntry));
+
+    return split;
+}
+
+/*
+ *
+ * Compresses n entries into dst, which must have room for
+ * PGLZ_MAX_OUTPUT of their size. Entries that don't compress are copied
+ * raw. Returns number of bytes written.
+ *
+ */
+static int32 verint_compress_block(const VersionedIntEntry *entries, int32 n, char *dst)
+{
+    int32 rawSize = n * sizeof(VersionedIntEntry);
+    int32 size = pglz_compress((const char *)entries, rawSize, dst, PGLZ_strategy_default);
+
+    if (size < 0 || size >= rawSize)
+    {
+        memcpy(dst, entries, rawSize);
+        return rawSize;
+    }
+
+    return size;
+}
+
+/*
+ *
+ * Copies n entries starting at index from into dst.
+ *
+ */
+static void verint_copy_entries(VersionedIntEntry *dst, VersionedInt *src, int32 from, int32 n)
+{
+    if (n <= 0)
+        return;
+
+    memcpy(dst, &src->entries[from], n * sizeof(VersionedIntEntry));
+}
+
+static VerintMinMax get_versioned_ints_min_max(VersionedInt *verint)
+{
+    VerintMinMax ret = {INT64_MAX, INT64_MIN};
+    int i;
+    for (i = 0; i < verint->count; i++)
+    {
+        ret.verint_max = Max(verint->entries[i].value, ret.verint_max);
+        ret.verint_min = Min(verint->entries[i].value, ret.verint_min);
+    }
+
+    return ret;
+}
+
+/*
+ *
+ * COMPARISON OPERATORS FOR versioned_int and bigint
+ *
+ */
+/* versioned_int = bigint */
+PG_FUNCTION_INFO_V1(versioned_int_eq_bigint);
+Datum versioned_int_eq_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 bigInt = PG_GETARG_INT64(1);
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(current.value == bigInt);
+}
+
+/* versioned_int <> bigint */
+PG_FUNCTION_INFO_V1(versioned_int_neq_bigint);
+Datum versioned_int_neq_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 bigInt = PG_GETARG_INT64(1);
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(current.value != bigInt);
+}
+
+/* versioned_int > bigint */
+PG_FUNCTION_INFO_V1(versioned_int_gt_bigint);
+Datum versioned_int_gt_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 bigInt = PG_GETARG_INT64(1);
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(current.value > bigInt);
+}
+
+/* versioned_int >= bigint */
+PG_FUNCTION_INFO_V1(versioned_int_ge_bigint);
+Datum versioned_int_ge_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 bigInt = PG_GETARG_INT64(1);
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(current.value >= bigInt);
+}
+
+/* versioned_int < bigint */
+PG_FUNCTION_INFO_V1(versioned_int_lt_bigint);
+Datum versioned_int_lt_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 bigInt = PG_GETARG_INT64(1);
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(current.value < bigInt);
+}
+
+/* versioned_int <= bigint */
+PG_FUNCTION_INFO_V1(versioned_int_le_bigint);
+Datum versioned_int_le_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 bigInt = PG_GETARG_INT64(1);
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(current.value <= bigInt);
+}
+
+/*
+ *
+ * COMPARISON OPERATORS FOR bigint and verint
+ *
+ */
+/* bigint  =  versioned_int */
+PG_FUNCTION_INFO_V1(bigint_eq_versioned_int);
+Datum bigint_eq_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 bigInt = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(bigInt == current.value);
+}
+
+/* bigint  <>  versioned_int */
+PG_FUNCTION_INFO_V1(bigint_neq_versioned_int);
+Datum bigint_neq_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 bigInt = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(bigInt != current.value);
+}
+
+/* bigint  >  versioned_int */
+PG_FUNCTION_INFO_V1(bigint_gt_versioned_int);
+Datum bigint_gt_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 bigInt = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(bigInt > current.value);
+}
+
+/* bigint  >=  versioned_int */
+PG_FUNCTION_INFO_V1(bigint_ge_versioned_int);
+Datum bigint_ge_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 bigInt = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(bigInt >= current.value);
+}
+
+/* bigint  <  versioned_int */
+PG_FUNCTION_INFO_V1(bigint_lt_versioned_int);
+Datum bigint_lt_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 bigInt = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(bigInt < current.value);
+}
+
+/* bigint  <=  versioned_int */
+PG_FUNCTION_INFO_V1(bigint_le_versioned_int);
+Datum bigint_le_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 bigInt = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(bigInt <= current.value);
+}
+
+/*
+ *
+ * COMPARISON OPERATORS FOR verint and verint
+ *
+ * These back the btree opclass, so unlike comparisons with bigint they
+ * never return NULL: they follow versioned_int_cmp_current, which sorts
+ * empty histories first.
+ *
+ */
+/* verint = verint */
+PG_FUNCTION_INFO_V1(versioned_int_eq_versioned_int);
+Datum versioned_int_eq_versioned_int(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_BOOL(versioned_int_cmp_current(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) == 0);
+}
+
+/* verint <> verint */
+PG_FUNCTION_INFO_V1(versioned_int_neq_versioned_int);
+Datum versioned_int_neq_versioned_int(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_BOOL(versioned_int_cmp_current(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) != 0);
+}
+
+/* verint > verint */
+PG_FUNCTION_INFO_V1(versioned_int_gt_versioned_int);
+Datum versioned_int_gt_versioned_int(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_BOOL(versioned_int_cmp_current(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) > 0);
+}
+
+/* verint >= verint */
+PG_FUNCTION_INFO_V1(versioned_int_ge_versioned_int);
+Datum versioned_int_ge_versioned_int(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_BOOL(versioned_int_cmp_current(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) >= 0);
+}
+
+/* verint < verint */
+PG_FUNCTION_INFO_V1(versioned_int_lt_versioned_int);
+Datum versioned_int_lt_versioned_int(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_BOOL(versioned_int_cmp_current(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) < 0);
+}
+
+/* verint <= verint */
+PG_FUNCTION_INFO_V1(versioned_int_le_versioned_int);
+Datum versioned_int_le_versioned_int(PG_FUNCTION_ARGS)
+{
+    PG_RETURN_BOOL(versioned_int_cmp_current(PG_GETARG_DATUM(0), PG_GETARG_DATUM(1)) <= 0);
+}
+
+/*
+ *
+ * ARITHMETIC OPERATORS FOR verint and bigint
+ *
+ */
+/* versioned_int + bigint */
+PG_FUNCTION_INFO_V1(versioned_int_add_bigint);
+Datum versioned_int_add_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 arg = PG_GETARG_INT64(1);
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    result = current.value + arg;
+    PG_RETURN_INT64(result);
+}
+
+/* versioned_int - bigint */
+PG_FUNCTION_INFO_V1(versioned_int_sub_bigint);
+Datum versioned_int_sub_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 arg = PG_GETARG_INT64(1);
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    result = current.value - arg;
+    PG_RETURN_INT64(result);
+}
+
+/* versioned_int * bigint */
+PG_FUNCTION_INFO_V1(versioned_int_mul_bigint);
+Datum versioned_int_mul_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 arg = PG_GETARG_INT64(1);
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    result = current.value * arg;
+    PG_RETURN_INT64(result);
+}
+
+/* versioned_int / bigint */
+PG_FUNCTION_INFO_V1(versioned_int_div_bigint);
+Datum versioned_int_div_bigint(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current;
+    int64 arg = PG_GETARG_INT64(1);
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    if (arg == 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("division by 0")));
+    }
+
+    result = current.value / arg;
+    PG_RETURN_INT64(result);
+}
+
+/*
+ *
+ * ARITHMETIC OPERATORS FOR bigint and verint
+ *
+ */
+/* bigint + verint */
+PG_FUNCTION_INFO_V1(bigint_add_versioned_int);
+Datum bigint_add_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 arg = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    result = arg + current.value;
+    PG_RETURN_INT64(result);
+}
+
+/* bigint - verint */
+PG_FUNCTION_INFO_V1(bigint_sub_versioned_int);
+Datum bigint_sub_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 arg = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    result = arg - current.value;
+    PG_RETURN_INT64(result);
+}
+
+/* bigint * verint */
+PG_FUNCTION_INFO_V1(bigint_mul_versioned_int);
+Datum bigint_mul_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 arg = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    result = arg * current.value;
+    PG_RETURN_INT64(result);
+}
+
+/* bigint / verint */
+PG_FUNCTION_INFO_V1(bigint_div_versioned_int);
+Datum bigint_div_versioned_int(PG_FUNCTION_ARGS)
+{
+    int64 arg = PG_GETARG_INT64(0);
+    VersionedIntEntry current;
+    int64 denominator, result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(1), &current))
+        PG_RETURN_NULL();
+
+    denominator = current.value;
+    if (denominator == 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("division by 0")));
+    }
+
+    result = arg / denominator;
+    PG_RETURN_INT64(result);
+}
+
+/*
+ *
+ * ARITHMETIC OPERATORS FOR verint and verint
+ *
+ */
+/* verint + verint */
+PG_FUNCTION_INFO_V1(versioned_int_add_versioned_int);
+Datum versioned_int_add_versioned_int(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current1;
+    VersionedIntEntry current2;
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current1) ||
+        !verint_fetch_last(PG_GETARG_DATUM(1), &current2))
+        PG_RETURN_NULL();
+
+    result = current1.value + current2.value;
+    PG_RETURN_INT64(result);
+}
+
+/* verint - verint */
+PG_FUNCTION_INFO_V1(versioned_int_sub_versioned_int);
+Datum versioned_int_sub_versioned_int(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current1;
+    VersionedIntEntry current2;
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current1) ||
+        !verint_fetch_last(PG_GETARG_DATUM(1), &current2))
+        PG_RETURN_NULL();
+
+    result = current1.value - current2.value;
+    PG_RETURN_INT64(result);
+}
+
+/* verint * verint */
+PG_FUNCTION_INFO_V1(versioned_int_mul_versioned_int);
+Datum versioned_int_mul_versioned_int(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current1;
+    VersionedIntEntry current2;
+    int64 result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current1) ||
+        !verint_fetch_last(PG_GETARG_DATUM(1), &current2))
+        PG_RETURN_NULL();
+
+    result = current1.value * current2.value;
+    PG_RETURN_INT64(result);
+}
+
+/* verint / verint */
+PG_FUNCTION_INFO_V1(versioned_int_div_versioned_int);
+Datum versioned_int_div_versioned_int(PG_FUNCTION_ARGS)
+{
+    VersionedIntEntry current1;
+    VersionedIntEntry current2;
+    int64 denominator, result;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current1) ||
+        !verint_fetch_last(PG_GETARG_DATUM(1), &current2))
+        PG_RETURN_NULL();
+
+    denominator = current2.value;
+    if (denominator == 0)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+                 errmsg("division by 0")));
+    }
+
+    result = current1.value / denominator;
+    PG_RETURN_INT64(result);
+}
+
+/*
+ *
+ * POINTWISE ARITHMETIC FOR verint and verint
+ *
+ * Unlike operators above, these combine whole histories: result has an
+ * entry at every change point of either operand since both existed,
+ * holding operation applied to values in effect at that time.
+ *
+ */
+/* verint +~ verint */
+PG_FUNCTION_INFO_V1(versioned_int_zip_add);
+Datum versioned_int_zip_add(PG_FUNCTION_ARGS)
+{
+    VersionedInt *result = verint_zip(verint_detoast(PG_GETARG_DATUM(0)),
+                                      verint_detoast(PG_GETARG_DATUM(1)), '+');
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_POINTER(result);
+}
+
+/* verint -~ verint */
+PG_FUNCTION_INFO_V1(versioned_int_zip_sub);
+Datum versioned_int_zip_sub(PG_FUNCTION_ARGS)
+{
+    VersionedInt *result = verint_zip(verint_detoast(PG_GETARG_DATUM(0)),
+                                      verint_detoast(PG_GETARG_DATUM(1)), '-');
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_POINTER(result);
+}
+
+/* verint *~ verint */
+PG_FUNCTION_INFO_V1(versioned_int_zip_mul);
+Datum versioned_int_zip_mul(PG_FUNCTION_ARGS)
 {
-    TimestampTz lo_t = Min(r1->lower_tzbound, r2->lower_tzbound);
-    TimestampTz hi_t = Max(r1->upper_tzbound, r2->upper_tzbound);
-    int64 lo_v = Min(r1->lower_val, r2->lower_val);
-    int64 hi_v = Max(r1->upper_val, r2->upper_val);
+    VersionedInt *result = verint_zip(verint_detoast(PG_GETARG_DATUM(0)),
+                                      verint_detoast(PG_GETARG_DATUM(1)), '*');
 
-    return (float8)(hi_t - lo_t) * (float8)(hi_v - lo_v);
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_POINTER(result);
 }
 
-static inline void get_union_rect(const verint_rect *r1, const verint_rect *r2, verint_rect *dst)
+/* verint /~ verint */
+PG_FUNCTION_INFO_V1(versioned_int_zip_div);
+Datum versioned_int_zip_div(PG_FUNCTION_ARGS)
 {
-    dst->lower_tzbound = Min(r1->lower_tzbound, r2->lower_tzbound);
-    dst->upper_tzbound = Max(r1->upper_tzbound, r2->upper_tzbound);
-    dst->lower_val = Min(r1->lower_val, r2->lower_val);
-    dst->upper_val = Max(r1->upper_val, r2->upper_val);
+    VersionedInt *result = verint_zip(verint_detoast(PG_GETARG_DATUM(0)),
+                                      verint_detoast(PG_GETARG_DATUM(1)), '/');
+
+    if (result == NULL)
+        PG_RETURN_NULL();
+
+    PG_RETURN_POINTER(result);
 }
 
-Datum versioned_int_picksplit(PG_FUNCTION_ARGS)
+/*
+ *
+ * Merges two time ordered histories in one linear pass. Entries sharing
+ * a timestamp are consumed together, so each distinct change point
+ * yields one entry. Returns NULL if operands never existed at once.
+ *
+ */
+static VersionedInt *verint_zip(VersionedInt *a, VersionedInt *b, char op)
 {
-    GistEntryVector *entryvec = (GistEntryVector *)PG_GETARG_POINTER(0);
-    GIST_SPLITVEC *v = (GIST_SPLITVEC *)PG_GETARG_POINTER(1);
+    VersionedInt *newVerint;
+    VersionedIntEntry *merged;
+    VersionedIntEntry *entry;
+    TimestampTz time;
+    int64 valueA = 0, valueB = 0;
+    bool haveA = false, haveB = false;
+    bool overflow;
+    int32 i = 0, j = 0, count = 0;
 
-    OffsetNumber maxoff = entryvec->n - 1;
-    OffsetNumber i, j;
-    int nbytes;
-    verint_rect *unionL, *unionR, *r, tmpL, tmpR;
-    float8 enlargementL, enlargementR;
+    merged = (VersionedIntEntry *)palloc(((Size)a->count + b->count) * sizeof(VersionedIntEntry));
+    while (i < a->count || j < b->count)
+    {
+        if (j >= b->count || (i < a->count && verint_entry(a, i)->time <= verint_entry(b, j)->time))
+            time = verint_entry(a, i)->time;
+        else
+            time = verint_entry(b, j)->time;
 
-    int seed1 = -1, seed2 = -1;
-    float8 worst_waste = -1;
+        while (i < a->count && (entry = verint_entry(a, i))->time == time)
+        {
+            valueA = entry->value;
+            haveA = true;
+            i++;
+        }
+        while (j < b->count && (entry = verint_entry(b, j))->time == time)
+        {
+            valueB = entry->value;
+            haveB = true;
+            j++;
+        }
 
-    for (i = FirstOffsetNumber; i < maxoff; i = OffsetNumberNext(i))
+        if (!haveA || !haveB)
+            continue;
+
+        merged[count].time = time;
+        switch (op)
+        {
+        case '+':
+            overflow = pg_add_s64_overflow(valueA, valueB, &merged[count].value);
+            break;
+        case '-':
+            overflow = pg_sub_s64_overflow(valueA, valueB, &merged[count].value);
+            break;
+        case '*':
+            overflow = pg_mul_s64_overflow(valueA, valueB, &merged[count].value);
+            break;
+        default:
+            if (valueB == 0)
+            {
+                ereport(ERROR,
+                        (errcode(ERRCODE_DIVISION_BY_ZERO),
+                         errmsg("division by zero")));
+            }
+
+            /* PG_INT64_MIN / -1 traps, so -1 is handled as negation */
+            if (valueB == -1)
+                overflow = pg_sub_s64_overflow(0, valueA, &merged[count].value);
+            else
+            {
+                merged[count].value = valueA / valueB;
+                overflow = false;
+            }
+            break;
+        }
+        if (overflow)
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+                     errmsg("bigint out of range")));
+        }
+        count++;
+    }
+
+    if (count == 0)
+    {
+        pfree(merged);
+        return NULL;
+    }
+
+    newVerint = verint_alloc(count, count, 0);
+    memcpy(newVerint->entries, merged, count * sizeof(VersionedIntEntry));
+    pfree(merged);
+
+    return newVerint;
+}
+
+/*
+ *
+ * AGGREGATE versioned_int_sum_series(versioned_int)
+ *
+ * Sums step functions of all inputs into one versioned_int, with an
+ * entry at every time the total changed. Input contributes nothing
+ * before its first entry.
+ *
+ */
+PG_FUNCTION_INFO_V1(versioned_int_sum_series_trans);
+Datum versioned_int_sum_series_trans(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggContext;
+    VerintSumState *state;
+    VersionedInt *versionedInt;
+    VersionedIntEntry *entry;
+    int64 prevValue = 0;
+    int32 i;
+
+    if (!AggCheckCallContext(fcinfo, &aggContext))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED)),
+                errmsg("versioned_int_sum_series_trans called in non-aggregate context"));
+    }
+
+    if (PG_ARGISNULL(0))
+    {
+        state = verint_sum_state_new(aggContext, VERINT_SUM_INITIAL_CAP);
+    }
+    else
+    {
+        state = (VerintSumState *)PG_GETARG_POINTER(0);
+    }
+
+    if (PG_ARGISNULL(1))
+        PG_RETURN_POINTER(state);
+
+    versionedInt = verint_detoast(PG_GETARG_DATUM(1));
+    verint_sum_reserve(state, versionedInt->count);
+    for (i = 0; i < versionedInt->count; i++)
+    {
+        entry = verint_entry(versionedInt, i);
+        state->deltas[state->count].time = entry->time;
+        if (pg_sub_s64_overflow(entry->value, prevValue, &state->deltas[state->count].value))
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+                     errmsg("bigint out of range")));
+        }
+        state->count++;
+        prevValue = entry->value;
+    }
+
+    PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(versioned_int_sum_series_combine);
+Datum versioned_int_sum_series_combine(PG_FUNCTION_ARGS)
+{
+    MemoryContext aggContext;
+    VerintSumState *state1;
+    VerintSumState *state2;
+
+    if (!AggCheckCallContext(fcinfo, &aggContext))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_FEATURE_NOT_SUPPORTED)),
+                errmsg("versioned_int_sum_series_combine called in non-aggregate context"));
+    }
+
+    if (PG_ARGISNULL(1))
+    {
+        if (PG_ARGISNULL(0))
+            PG_RETURN_NULL();
+
+        PG_RETURN_POINTER(PG_GETARG_POINTER(0));
+    }
+
+    state2 = (VerintSumState *)PG_GETARG_POINTER(1);
+    if (PG_ARGISNULL(0))
+    {
+        state1 = verint_sum_state_new(aggContext, Max(state2->count, VERINT_SUM_INITIAL_CAP));
+    }
+    else
+    {
+        state1 = (VerintSumState *)PG_GETARG_POINTER(0);
+    }
+
+    verint_sum_reserve(state1, state2->count);
+    memcpy(&state1->deltas[state1->count], state2->deltas, state2->count * sizeof(VersionedIntEntry));
+    state1->count += state2->count;
+
+    PG_RETURN_POINTER(state1);
+}
+
+PG_FUNCTION_INFO_V1(versioned_int_sum_series_serialize);
+Datum versioned_int_sum_series_serialize(PG_FUNCTION_ARGS)
+{
+    VerintSumState *state = (VerintSumState *)PG_GETARG_POINTER(0);
+    Size size;
+    bytea *result;
+
+    verint_sum_compact(state);
+
+    size = state->count * sizeof(VersionedIntEntry);
+    if (size >= (Size)MAX_VERSIONED_INT_SIZE)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_OUT_OF_MEMORY)),
+                errmsg("Partial sum of series would exceed 512MB. Aborting"));
+    }
+
+    result = (bytea *)palloc(VARHDRSZ + size);
+    SET_VARSIZE(result, VARHDRSZ + size);
+    memcpy(VARDATA(result), state->deltas, size);
+
+    PG_RETURN_BYTEA_P(result);
+}
+
+PG_FUNCTION_INFO_V1(versioned_int_sum_series_deserialize);
+Datum versioned_int_sum_series_deserialize(PG_FUNCTION_ARGS)
+{
+    bytea *serialized = PG_GETARG_BYTEA_PP(0);
+    int64 count = VARSIZE_ANY_EXHDR(serialized) / sizeof(VersionedIntEntry);
+    VerintSumState *state = verint_sum_state_new(CurrentMemoryContext, Max(count, 1));
+
+    memcpy(state->deltas, VARDATA_ANY(serialized), count * sizeof(VersionedIntEntry));
+    state->count = count;
+    state->compacted = count;
+
+    PG_RETURN_POINTER(state);
+}
+
+PG_FUNCTION_INFO_V1(versioned_int_sum_series_final);
+Datum versioned_int_sum_series_final(PG_FUNCTION_ARGS)
+{
+    VerintSumState *state;
+    VersionedInt *newVerint;
+    int64 sum = 0;
+    int64 i, count = 0;
+
+    if (PG_ARGISNULL(0))
+        PG_RETURN_NULL();
+
+    state = (VerintSumState *)PG_GETARG_POINTER(0);
+    verint_sum_compact(state);
+
+    for (i = 0; i < state->count; i++)
+    {
+        if (i == 0 || state->deltas[i].value != 0)
+            count++;
+    }
+
+    if (count == 0)
+        PG_RETURN_NULL();
+
+    if (VERINT_SIZE(count, 0) >= (Size)MAX_VERSIONED_INT_SIZE)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_OUT_OF_MEMORY)),
+                errmsg("Sum of series would push it pass the size of 512MB. Aborting"));
+    }
+
+    newVerint = verint_alloc(count, count, 0);
+    count = 0;
+    for (i = 0; i < state->count; i++)
+    {
+        if (pg_add_s64_overflow(sum, state->deltas[i].value, &sum))
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+                     errmsg("bigint out of range")));
+        }
+        if (i == 0 || state->deltas[i].value != 0)
+        {
+            newVerint->entries[count].time = state->deltas[i].time;
+            newVerint->entries[count].value = sum;
+            count++;
+        }
+    }
+
+    PG_RETURN_POINTER(newVerint);
+}
+
+static VerintSumState *verint_sum_state_new(MemoryContext context, int64 cap)
+{
+    MemoryContext oldContext = MemoryContextSwitchTo(context);
+    VerintSumState *state = (VerintSumState *)palloc(sizeof(VerintSumState));
+
+    state->deltas = (VersionedIntEntry *)MemoryContextAllocHuge(context, cap * sizeof(VersionedIntEntry));
+    state->count = 0;
+    state->cap = cap;
+    state->compacted = 0;
+    MemoryContextSwitchTo(oldContext);
+
+    return state;
+}
+
+/*
+ *
+ * Makes room for n more events, compacting before growing if enough
+ * events were added since last compaction.
+ *
+ */
+static void verint_sum_reserve(VerintSumState *state, int64 n)
+{
+    if (state->count + n <= state->cap)
+        return;
+
+    if (state->count >= 2 * state->compacted)
+        verint_sum_compact(state);
+
+    if (state->count + n > state->cap)
+    {
+        state->cap = Max(2 * state->cap, state->count + n);
+        state->deltas = (VersionedIntEntry *)repalloc_huge(state->deltas, state->cap * sizeof(VersionedIntEntry));
+    }
+}
+
+/*
+ *
+ * Sorts events by time and sums those sharing a timestamp. Keeps
+ * events whose sum is zero, since they may mark start of the series.
+ *
+ */
+static void verint_sum_compact(VerintSumState *state)
+{
+    int64 i, n = 0;
+
+    if (state->count == state->compacted)
+        return;
+
+    qsort(state->deltas, state->count, sizeof(VersionedIntEntry), verint_delta_cmp);
+    for (i = 0; i < state->count; i++)
+    {
+        if (n > 0 && state->deltas[n - 1].time == state->deltas[i].time)
+        {
+            if (pg_add_s64_overflow(state->deltas[n - 1].value, state->deltas[i].value, &state->deltas[n - 1].value))
+            {
+                ereport(ERROR,
+                        (errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+                         errmsg("bigint out of range")));
+            }
+        }
+        else
+        {
+            state->deltas[n++] = state->deltas[i];
+        }
+    }
+
+    state->count = n;
+    state->compacted = n;
+}
+
+static int verint_delta_cmp(const void *a, const void *b)
+{
+    TimestampTz at = ((const VersionedIntEntry *)a)->time;
+    TimestampTz bt = ((const VersionedIntEntry *)b)->time;
+
+    if (at < bt)
+        return -1;
+    if (at > bt)
+        return 1;
+
+    return 0;
+}
+
+/*
+ *
+ * VERSIONED_ROW, history of several integer columns sharing one time axis
+ *
+ */
+
+/*
+ *
+ * Input function for versioned_row. Like for versioned_int, conversion
+ * from text is disabled.
+ *
+ */
+Datum versioned_row_in(PG_FUNCTION_ARGS)
+{
+    ereport(ERROR,
+            (errcode(ERRCODE_FEATURE_NOT_SUPPORTED)),
+            errmsg("Conversion between text representation and versioned_row is not possible"));
+}
+
+/*
+ *
+ * Output function for versioned_row, prints current values of all
+ * columns as (v1,v2,...).
+ *
+ */
+Datum versioned_row_out(PG_FUNCTION_ARGS)
+{
+    VersionedRow *row = (VersionedRow *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+    StringInfoData buf;
+    int64 *values;
+    int32 i;
+
+    if (row->count == 0)
+    {
+        PG_RETURN_CSTRING(psprintf("NULL"));
+    }
+
+    values = VERROW_VALUES(row, row->count - 1);
+    initStringInfo(&buf);
+    appendStringInfoChar(&buf, '(');
+    for (i = 0; i < row->ncols; i++)
+    {
+        if (i > 0)
+            appendStringInfoChar(&buf, ',');
+        appendStringInfo(&buf, "%ld", values[i]);
+    }
+    appendStringInfoChar(&buf, ')');
+
+    PG_RETURN_CSTRING(buf.data);
+}
+
+/*
+ *
+ * make_versioned_row adds new values of all columns to row's history,
+ * stamped with transaction's first write timestamp like make_versioned.
+ * Values are VARIADIC, so they arrive as one bigint array.
+ * is called like
+ * make_versioned_row(NULL::versioned_row, 1, 2, 3)
+ * make_versioned_row(verrow, VARIADIC ARRAY[1, 2, 3])
+ *
+ */
+Datum make_versioned_row(PG_FUNCTION_ARGS)
+{
+    if (PG_ARGISNULL(1))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED)),
+                errmsg("Cannot insert \"null\" as the value of versioned_row type"));
+    }
+
+    PG_RETURN_POINTER(verrow_insert(PG_ARGISNULL(0) ? (Datum)0 : PG_GETARG_DATUM(0),
+                                    PG_GETARG_ARRAYTYPE_P(1), get_first_write_ts()));
+}
+
+/*
+ *
+ * make_versioned_row_with_ts adds new values of all columns to row's
+ * history at given timestamp.
+ * is called like
+ * make_versioned_row_with_ts(NULL, ARRAY[1, 2, 3], timestamp)
+ * make_versioned_row_with_ts(verrow, ARRAY[1, 2, 3], timestamp)
+ *
+ */
+Datum make_versioned_row_with_ts(PG_FUNCTION_ARGS)
+{
+    if (PG_ARGISNULL(1))
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED)),
+                errmsg("Cannot insert \"null\" as the value of versioned_row type"));
+    }
+    if (PG_ARGISNULL(2))
     {
-        verint_rect *r1 = (verint_rect *)DatumGetPointer(entryvec->vector[i].key);
-        for (j = OffsetNumberNext(i); j <= maxoff; j = OffsetNumberNext(j))
-        {
-            verint_rect *r2 = (verint_rect *)DatumGetPointer(entryvec->vector[j].key);
+        ereport(ERROR,
+                (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED)),
+                errmsg("Cannot insert \"null\" as the timestamp of versioned_row type"));
+    }
 
-            float8 area1 = get_area(r1);
-            float8 area2 = get_area(r2);
-            float8 union_area = get_union_area(r1, r2);
-            float8 waste = union_area - area1 - area2;
+    PG_RETURN_POINTER(verrow_insert(PG_ARGISNULL(0) ? (Datum)0 : PG_GETARG_DATUM(0),
+                                    PG_GETARG_ARRAYTYPE_P(1), PG_GETARG_TIMESTAMPTZ(2)));
+}
 
-            if (waste > worst_waste)
-            {
-                worst_waste = waste;
-                seed1 = i;
-                seed2 = j;
-            }
-        }
+/*
+ *
+ * Snapshot of all columns at timestamp, i.e. versioned_row @ timestamp.
+ * Returns bigint array of column values, or null if row didn't exist at
+ * that time. Use versioned_row_populate to get named columns.
+ *
+ */
+Datum versioned_row_at_time(PG_FUNCTION_ARGS)
+{
+    VersionedRow *row = (VersionedRow *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+    int32 i = verrow_search(row, PG_GETARG_TIMESTAMPTZ(1));
+    Datum *values;
+    int64 *src;
+    int32 c;
+
+    if (i == 0)
+    {
+        PG_RETURN_NULL();
     }
 
-    nbytes = (maxoff + 1) * sizeof(OffsetNumber);
-    v->spl_left = (OffsetNumber *)palloc(nbytes);
-    v->spl_right = (OffsetNumber *)palloc(nbytes);
-    v->spl_nleft = v->spl_nright = 0;
+    values = (Datum *)palloc(row->ncols * sizeof(Datum));
+    src = VERROW_VALUES(row, i - 1);
+    for (c = 0; c < row->ncols; c++)
+        values[c] = Int64GetDatum(src[c]);
 
-    unionL = (verint_rect *)palloc(sizeof(verint_rect));
-    unionR = (verint_rect *)palloc(sizeof(verint_rect));
-    *unionL = *(verint_rect *)DatumGetPointer(entryvec->vector[seed1].key);
-    *unionR = *(verint_rect *)DatumGetPointer(entryvec->vector[seed2].key);
+    PG_RETURN_ARRAYTYPE_P(construct_array(values, row->ncols, INT8OID, sizeof(int64), FLOAT8PASSBYVAL,
+                                          TYPALIGN_DOUBLE));
+}
 
-    v->spl_left[v->spl_nleft++] = seed1;
-    v->spl_right[v->spl_nright++] = seed2;
+/*
+ *
+ * Snapshot of all columns at timestamp as a named composite type, i.e.
+ * versioned_row_populate(NULL::my_type, verrow, timestamp). Columns are
+ * matched by position and all of them must be bigint. This is the way to
+ * get a snapshot whose columns can be selected by name, like
+ * (versioned_row_populate(NULL::my_type, verrow, now())).a
+ *
+ */
+Datum versioned_row_populate(PG_FUNCTION_ARGS)
+{
+    Oid typid = get_fn_expr_argtype(fcinfo->flinfo, 0);
+    VersionedRow *row;
+    TupleDesc tupdesc;
+    Datum result;
+    int32 i, c;
 
-    for (i = FirstOffsetNumber; i <= maxoff; i = OffsetNumberNext(i))
+    if (PG_ARGISNULL(1) || PG_ARGISNULL(2))
     {
-        if (i == seed1 || i == seed2)
-            continue;
-
-        r = (verint_rect *)DatumGetPointer(entryvec->vector[i].key);
-
-        tmpL = *unionL;
-        tmpR = *unionR;
-        get_union_rect(unionL, r, &tmpL);
-        get_union_rect(unionR, r, &tmpR);
+        PG_RETURN_NULL();
+    }
 
-        enlargementL = get_area(&tmpL) - get_area(unionL);
-        enlargementR = get_area(&tmpR) - get_area(unionR);
+    row = (VersionedRow *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    i = verrow_search(row, PG_GETARG_TIMESTAMPTZ(2));
+    if (i == 0)
+    {
+        PG_RETURN_NULL();
+    }
 
-        if (enlargementL < enlargementR ||
-            (enlargementL == enlargementR && get_area(unionL) < get_area(unionR)))
-        {
-            v->spl_left[v->spl_nleft++] = i;
-            *unionL = tmpL;
-        }
-        else
+    tupdesc = lookup_rowtype_tupdesc(typid, -1);
+    for (c = 0; c < tupdesc->natts; c++)
+    {
+        if (TupleDescAttr(tupdesc, c)->atttypid != INT8OID)
         {
-            v->spl_right[v->spl_nright++] = i;
-            *unionR = tmpR;
+            ereport(ERROR,
+                    (errcode(ERRCODE_DATATYPE_MISMATCH)),
+                    errmsg("All columns of type populated from versioned_row must be bigint"));
         }
     }
+    if (tupdesc->natts != row->ncols)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_DATATYPE_MISMATCH)),
+                errmsg("versioned_row has %d columns, type has %d", row->ncols, tupdesc->natts));
+    }
 
-    v->spl_ldatum = PointerGetDatum(unionL);
-    v->spl_rdatum = PointerGetDatum(unionR);
+    result = verrow_tuple(row, i - 1, tupdesc);
+    ReleaseTupleDesc(tupdesc);
 
-    PG_RETURN_POINTER(v);
+    PG_RETURN_DATUM(result);
 }
 
 /*
  *
- * Some Btree index method functions so that versioned_int could use
- * ORDER BY, DISTINCT etc.
+ * History of a single column (counted from 1) as versioned_int, so that
+ * all of versioned_int's functions can be used on it.
  *
  */
-static int versioned_int_cmp_internal(VersionedInt *a, VersionedInt *b)
+Datum versioned_row_column(PG_FUNCTION_ARGS)
 {
-    int64 av = a->entries[a->count - 1].value;
-    int64 bv = b->entries[b->count - 1].value;
+    VersionedRow *row = (VersionedRow *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
+    int32 column = PG_GETARG_INT32(1);
+    VersionedInt *result;
+    int32 i;
 
-    if (av < bv)
+    if (column < 1 || column > row->ncols)
     {
-        return -1;
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                errmsg("Column must be between 1 and %d", row->ncols));
     }
-    if (av > bv)
+
+    result = verint_alloc(row->count, row->count, 0);
+    for (i = 0; i < row->count; i++)
     {
-        return 1;
+        result->entries[i].value = VERROW_VALUES(row, i)[column - 1];
+        result->entries[i].time = row->times[i];
     }
 
-    return 0;
+    PG_RETURN_POINTER(verint_maybe_encode(result));
 }
 
-Datum versioned_int_btree_cmp(PG_FUNCTION_ARGS)
+static VersionedRow *verrow_alloc(int32 cap, int32 count, int32 ncols)
 {
-    VersionedInt *a = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *b = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    Size size = VERROW_SIZE(cap, ncols);
+    VersionedRow *row = (VersionedRow *)palloc(size);
+
+    SET_VARSIZE(row, size);
+    row->count = count;
+    row->cap = cap;
+    row->ncols = ncols;
 
-    PG_RETURN_INT32(versioned_int_cmp_internal(a, b));
+    return row;
 }
 
-static int32 get_ts_insert_location(VersionedIntEntry *entries, int32 count, TimestampTz time)
+/*
+ *
+ * Returns copy of row stored in datum (empty if datum is 0) with values
+ * inserted at time. Rows are kept sorted by time, a row with the same
+ * time as existing ones goes after them so it's the one seen by lookups.
+ *
+ */
+static VersionedRow *verrow_insert(Datum datum, ArrayType *values, TimestampTz time)
 {
-    int32 l = 0;
-    int32 r = count;
+    VersionedRow *row = NULL;
+    VersionedRow *newRow;
+    Datum *elems;
+    bool *nulls;
+    int nelems, i;
+    int32 cap, idx;
+    int64 *dst;
 
-    while (l < r)
+    if (ARR_NDIM(values) > 1)
     {
-        int32 mid = l + (r - l) / 2;
-
-        if (entries[mid].time < time)
+        ereport(ERROR,
+                (errcode(ERRCODE_ARRAY_SUBSCRIPT_ERROR)),
+                errmsg("Values of versioned_row must be a one dimensional array"));
+    }
+    deconstruct_array(values, INT8OID, sizeof(int64), FLOAT8PASSBYVAL, TYPALIGN_DOUBLE,
+                      &elems, &nulls, &nelems);
+    if (nelems == 0 || nelems > MaxHeapAttributeNumber)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                errmsg("versioned_row must have between 1 and %d columns", MaxHeapAttributeNumber));
+    }
+    for (i = 0; i < nelems; i++)
+    {
+        if (nulls[i])
         {
-            l = mid + 1;
+            ereport(ERROR,
+                    (errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED)),
+                    errmsg("Cannot insert \"null\" as the value of versioned_row type"));
         }
-        else
+    }
+
+    if (datum != (Datum)0)
+    {
+        row = (VersionedRow *)PG_DETOAST_DATUM(datum);
+        if (row->ncols != nelems)
         {
-            r = mid;
+            ereport(ERROR,
+                    (errcode(ERRCODE_INVALID_PARAMETER_VALUE)),
+                    errmsg("versioned_row has %d columns, got %d values", row->ncols, nelems));
         }
     }
 
-    return l;
-}
-
-static VersionedInt *enforce_N_retention(VersionedInt *versionedInt, int32 maxCap)
-{
-    VersionedInt *newVerint;
-    int32 drop;
-    if (versionedInt->cap <= maxCap && versionedInt->count <= maxCap)
+    if (row == NULL)
     {
-        return versionedInt;
+        newRow = verrow_alloc(1, 1, nelems);
+        idx = 0;
     }
+    else
+    {
+        cap = row->count == row->cap ? 2 * row->cap : row->cap;
+        if (VERROW_SIZE(cap, nelems) >= (Size)MAX_VERSIONED_INT_SIZE)
+        {
+            ereport(ERROR,
+                    (errcode(ERRCODE_OUT_OF_MEMORY)),
+                    errmsg("Extending column would push it pass the size of 512MB. Aborting"));
+        }
 
-    newVerint = (VersionedInt *)palloc0(sizeof(VersionedInt) + maxCap * sizeof(VersionedIntEntry));
-    SET_VARSIZE(newVerint, sizeof(VersionedInt) + maxCap * sizeof(VersionedIntEntry));
-    newVerint->cap = maxCap;
-    newVerint->count = Min(versionedInt->count, maxCap);
-    drop = Max(0, versionedInt->count - maxCap);
+        newRow = verrow_alloc(cap, row->count + 1, nelems);
+        idx = verrow_search(row, time);
 
-    memcpy(newVerint->entries, &versionedInt->entries[drop], newVerint->count * sizeof(VersionedIntEntry));
+        memcpy(newRow->times, row->times, idx * sizeof(TimestampTz));
+        memcpy(&newRow->times[idx + 1], &row->times[idx], (row->count - idx) * sizeof(TimestampTz));
+        memcpy(VERROW_VALUES(newRow, 0), VERROW_VALUES(row, 0), (Size)idx * nelems * sizeof(int64));
+        memcpy(VERROW_VALUES(newRow, idx + 1), VERROW_VALUES(row, idx),
+               (Size)(row->count - idx) * nelems * sizeof(int64));
+    }
 
-    return newVerint;
+    newRow->times[idx] = time;
+    dst = VERROW_VALUES(newRow, idx);
+    for (i = 0; i < nelems; i++)
+        dst[i] = DatumGetInt64(elems[i]);
+
+    return newRow;
 }
 
-static int32 first_time_greater_than_cutoff(VersionedIntEntry *entries, int32 count, TimestampTz cutoff)
+/*
+ *
+ * Returns number of rows with time <= given time, so row in effect at
+ * that time is the one before returned index.
+ *
+ */
+static int32 verrow_search(VersionedRow *row, TimestampTz time)
 {
     int32 l = 0;
-    int32 r = count - 1;
-    int32 result = count;
+    int32 r = row->count;
 
-    while (l <= r)
+    while (l < r)
     {
         int32 mid = l + (r - l) / 2;
-        if (entries[mid].time > cutoff)
+
+        if (row->times[mid] <= time)
         {
-            result = mid;
-            r = mid - 1;
+            l = mid + 1;
         }
         else
         {
-            l = mid + 1;
+            r = mid;
         }
     }
 
-    return result;
+    return l;
 }
 
-static VersionedInt *enforce_Time_retention(VersionedInt *versionedInt, int64 time)
+static Datum verrow_tuple(VersionedRow *row, int32 i, TupleDesc tupdesc)
 {
-    TimestampTz cutoffTime = GetCurrentTimestamp() - time;
-    int32 idx = first_time_greater_than_cutoff(versionedInt->entries, versionedInt->count, cutoffTime);
-    int32 newCount;
-    VersionedInt *newVerint;
-
-    if (idx == 0)
-        return versionedInt;
+    Datum *values = (Datum *)palloc(row->ncols * sizeof(Datum));
+    bool *nulls = (bool *)palloc0(row->ncols * sizeof(bool));
+    int64 *src = VERROW_VALUES(row, i);
+    int32 c;
 
-    newCount = versionedInt->count - idx;
+    for (c = 0; c < row->ncols; c++)
+        values[c] = Int64GetDatum(src[c]);
 
-    newVerint = (VersionedInt *)palloc0(sizeof(VersionedInt) + newCount * sizeof(VersionedIntEntry));
-    SET_VARSIZE(newVerint, sizeof(VersionedInt) + newCount * sizeof(VersionedIntEntry));
-    newVerint->cap = newCount;
-    newVerint->count = newCount;
+    return HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls));
+}
 
-    memcpy(newVerint->entries, &versionedInt->entries[idx], newCount * sizeof(VersionedIntEntry));
+/*
+ *
+ * VERSIONED_FLOAT8, history of double precision value. Values are kept
+ * as order preserving int64 keys (see verfloat_key) in versioned_int's
+ * layout, so storage, search, retention, GiST and comparison kernels are
+ * shared with versioned_int, specialized by VerintValueType. Stored
+ * values are Gorilla encoded, see VersionedIntXor.
+ *
+ */
 
-    return newVerint;
+/*
+ *
+ * Input function for versioned_float8. Like for versioned_int, conversion
+ * from text is disabled.
+ *
+ */
+Datum versioned_float8_in(PG_FUNCTION_ARGS)
+{
+    ereport(ERROR,
+            (errcode(ERRCODE_FEATURE_NOT_SUPPORTED)),
+            errmsg("Conversion between text representation and versioned_float8 is not possible"));
 }
 
 /*
  *
- * Helper function that given versioned_int and timestamp returns
- * versioned_ints value at that time or null if it didn't exist at
- * said time
+ * Output function for versioned_float8, prints current value. Gorilla
+ * encoded values keep it in the header, so nothing is decoded.
  *
  */
-static VersionedIntEntry *get_versioned_ints_value_at_time(VersionedInt *versionedInt, TimestampTz timestamp)
+Datum versioned_float8_out(PG_FUNCTION_ARGS)
 {
-    VersionedIntEntry *entries = versionedInt->entries;
-    int32 l = 0;
-    int32 r = versionedInt->count - 1;
-    int32 mid;
-
-    if (versionedInt->count == 0)
-    {
-        return NULL;
-    }
-    if (timestamp >= entries[versionedInt->count - 1].time)
-    {
-        return &entries[versionedInt->count - 1];
-    }
-
-    while (l <= r)
-    {
-        mid = l + (r - l) / 2;
-
-        if (entries[mid].time == timestamp)
-        {
-            return &entries[mid];
-        }
-        else if (entries[mid].time < timestamp)
-        {
-            l = mid + 1;
-        }
-        else
-        {
-            r = mid - 1;
-        }
-    }
+    VersionedIntEntry current;
 
-    if (r >= 0)
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
     {
-        return &entries[r];
+        PG_RETURN_CSTRING(psprintf("NULL"));
     }
 
-    return NULL;
+    PG_RETURN_CSTRING(float8out_internal(verfloat_value(current.value)));
 }
 
-static VerintMinMax get_versioned_ints_min_max(VersionedInt *verint)
+/*
+ *
+ * Function that enforces versioned_float8's type modifier on assignment,
+ * same as versioned_int_enforce_modifier.
+ *
+ */
+Datum versioned_float8_enforce_modifier(PG_FUNCTION_ARGS)
 {
-    VerintMinMax ret = {INT64_MAX, INT64_MIN};
-    int i;
-    for (i = 0; i < verint->count; i++)
-    {
-        ret.verint_max = Max(verint->entries[i].value, ret.verint_max);
-        ret.verint_min = Min(verint->entries[i].value, ret.verint_min);
-    }
-
-    return ret;
+    return enforce_modifier_internal(fcinfo, VERINT_FLOAT8);
 }
 
 /*
  *
- * COMPARISON OPERATORS FOR versioned_int and bigint
+ * make_versioned_float8 adds new value to float's history, stamped with
+ * transaction's first write timestamp like make_versioned.
+ * is called like
+ * make_versioned_float8(NULL, new_value)
+ * make_versioned_float8(verfloat, new_value)
  *
  */
-/* versioned_int = bigint */
-PG_FUNCTION_INFO_V1(versioned_int_eq_bigint);
-Datum versioned_int_eq_bigint(PG_FUNCTION_ARGS)
+Datum make_versioned_float8(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 bigInt = PG_GETARG_INT64(1);
-
-    PG_RETURN_BOOL(versionedInt->entries[versionedInt->count - 1].value == bigInt);
+    return make_versioned_internal(fcinfo, VERINT_FLOAT8);
 }
 
-/* versioned_int <> bigint */
-PG_FUNCTION_INFO_V1(versioned_int_neq_bigint);
-Datum versioned_int_neq_bigint(PG_FUNCTION_ARGS)
+/*
+ *
+ * make_versioned_float8_with_ts adds new value to float's history at
+ * given timestamp.
+ * is called like
+ * make_versioned_float8_with_ts(NULL, new_value, timestamp)
+ * make_versioned_float8_with_ts(verfloat, new_value, timestamp)
+ *
+ */
+Datum make_versioned_float8_with_ts(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 bigInt = PG_GETARG_INT64(1);
-
-    PG_RETURN_BOOL(versionedInt->entries[versionedInt->count - 1].value != bigInt);
+    return make_versioned_with_ts_internal(fcinfo, VERINT_FLOAT8);
 }
 
-/* versioned_int > bigint */
-PG_FUNCTION_INFO_V1(versioned_int_gt_bigint);
-Datum versioned_int_gt_bigint(PG_FUNCTION_ARGS)
+/*
+ *
+ * Value of versioned_float8 at timestamp, i.e. versioned_float8 @ timestamp.
+ *
+ */
+Datum versioned_float8_at_time(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 bigInt = PG_GETARG_INT64(1);
-
-    PG_RETURN_BOOL(versionedInt->entries[versionedInt->count - 1].value > bigInt);
-}
+    TimestampTz time_at = PG_GETARG_TIMESTAMPTZ(1);
+    VersionedIntEntry entry;
 
-/* versioned_int >= bigint */
-PG_FUNCTION_INFO_V1(versioned_int_ge_bigint);
-Datum versioned_int_ge_bigint(PG_FUNCTION_ARGS)
-{
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 bigInt = PG_GETARG_INT64(1);
+    if (!verint_lookup_at(PG_GETARG_DATUM(0), time_at, &entry))
+    {
+        PG_RETURN_NULL();
+    }
 
-    PG_RETURN_BOOL(versionedInt->entries[versionedInt->count - 1].value >= bigInt);
+    PG_RETURN_FLOAT8(verfloat_value(entry.value));
 }
 
-/* versioned_int < bigint */
-PG_FUNCTION_INFO_V1(versioned_int_lt_bigint);
-Datum versioned_int_lt_bigint(PG_FUNCTION_ARGS)
-{
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 bigInt = PG_GETARG_INT64(1);
-
-    PG_RETURN_BOOL(versionedInt->entries[versionedInt->count - 1].value < bigInt);
+/*
+ *
+ * Returns history of versioned_float8 as (updated_at, value) rows, whole
+ * or within tstzrange like get_history_range.
+ *
+ */
+Datum get_float8_history(PG_FUNCTION_ARGS)
+{
+    return get_history_internal(fcinfo, VERINT_FLOAT8);
 }
 
-/* versioned_int <= bigint */
-PG_FUNCTION_INFO_V1(versioned_int_le_bigint);
-Datum versioned_int_le_bigint(PG_FUNCTION_ARGS)
+Datum get_float8_history_range(PG_FUNCTION_ARGS)
 {
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 bigInt = PG_GETARG_INT64(1);
-
-    PG_RETURN_BOOL(versionedInt->entries[versionedInt->count - 1].value <= bigInt);
+    return get_history_range_internal(fcinfo, VERINT_FLOAT8);
 }
 
 /*
  *
- * COMPARISON OPERATORS FOR bigint and verint
+ * Time weighted aggregates of versioned_float8 over tstzrange, see
+ * versioned_int_twa.
  *
  */
-/* bigint  =  versioned_int */
-PG_FUNCTION_INFO_V1(bigint_eq_versioned_int);
-Datum bigint_eq_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_twa(PG_FUNCTION_ARGS)
 {
-    int64 bigInt = PG_GETARG_INT64(0);
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    VerintRangeStats stats;
+
+    if (!get_float8_range_stats(fcinfo, &stats, true))
+        PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(bigInt == versionedInt->entries[versionedInt->count - 1].value);
+    PG_RETURN_FLOAT8(stats.float_integral / (float8)stats.covered);
 }
 
-/* bigint  <>  versioned_int */
-PG_FUNCTION_INFO_V1(bigint_neq_versioned_int);
-Datum bigint_neq_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_integral(PG_FUNCTION_ARGS)
 {
-    int64 bigInt = PG_GETARG_INT64(0);
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    VerintRangeStats stats;
+
+    if (!get_float8_range_stats(fcinfo, &stats, true))
+        PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(bigInt != versionedInt->entries[versionedInt->count - 1].value);
+    PG_RETURN_FLOAT8(stats.float_integral / USECS_PER_SEC);
 }
 
-/* bigint  >  versioned_int */
-PG_FUNCTION_INFO_V1(bigint_gt_versioned_int);
-Datum bigint_gt_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_min(PG_FUNCTION_ARGS)
 {
-    int64 bigInt = PG_GETARG_INT64(0);
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    VerintRangeStats stats;
+
+    if (!get_float8_range_stats(fcinfo, &stats, false))
+        PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(bigInt > versionedInt->entries[versionedInt->count - 1].value);
+    PG_RETURN_FLOAT8(verfloat_value(stats.min));
 }
 
-/* bigint  >=  versioned_int */
-PG_FUNCTION_INFO_V1(bigint_ge_versioned_int);
-Datum bigint_ge_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_max(PG_FUNCTION_ARGS)
 {
-    int64 bigInt = PG_GETARG_INT64(0);
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    VerintRangeStats stats;
+
+    if (!get_float8_range_stats(fcinfo, &stats, false))
+        PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(bigInt >= versionedInt->entries[versionedInt->count - 1].value);
+    PG_RETURN_FLOAT8(verfloat_value(stats.max));
 }
 
-/* bigint  <  versioned_int */
-PG_FUNCTION_INFO_V1(bigint_lt_versioned_int);
-Datum bigint_lt_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_first(PG_FUNCTION_ARGS)
 {
-    int64 bigInt = PG_GETARG_INT64(0);
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    VerintRangeStats stats;
+
+    if (!get_float8_range_stats(fcinfo, &stats, false))
+        PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(bigInt < versionedInt->entries[versionedInt->count - 1].value);
+    PG_RETURN_FLOAT8(verfloat_value(stats.first));
 }
 
-/* bigint  <=  versioned_int */
-PG_FUNCTION_INFO_V1(bigint_le_versioned_int);
-Datum bigint_le_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_last(PG_FUNCTION_ARGS)
 {
-    int64 bigInt = PG_GETARG_INT64(0);
-    VersionedInt *versionedInt = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    VerintRangeStats stats;
+
+    if (!get_float8_range_stats(fcinfo, &stats, false))
+        PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(bigInt <= versionedInt->entries[versionedInt->count - 1].value);
+    PG_RETURN_FLOAT8(verfloat_value(stats.last));
 }
 
 /*
  *
- * COMPARISON OPERATORS FOR verint and verint
+ * Functions behind versioned_float8 @= ts_float8 and friends, see
+ * versioned_int_at_time_eq.
  *
  */
-/* verint = verint */
-PG_FUNCTION_INFO_V1(versioned_int_eq_versioned_int);
-Datum versioned_int_eq_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_at_time_eq(PG_FUNCTION_ARGS)
 {
-    VersionedInt *a = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *b = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-
-    PG_RETURN_BOOL(a->entries[a->count - 1].value ==
-                   b->entries[b->count - 1].value);
+    return verint_at_time_op(fcinfo, 1, VERINT_FLOAT8);
 }
 
-/* verint <> verint */
-PG_FUNCTION_INFO_V1(versioned_int_neq_versioned_int);
-Datum versioned_int_neq_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_at_time_lt(PG_FUNCTION_ARGS)
 {
-    VersionedInt *a = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *b = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-
-    PG_RETURN_BOOL(a->entries[a->count - 1].value !=
-                   b->entries[b->count - 1].value);
+    return verint_at_time_op(fcinfo, 2, VERINT_FLOAT8);
 }
 
-/* verint > verint */
-PG_FUNCTION_INFO_V1(versioned_int_gt_versioned_int);
-Datum versioned_int_gt_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_at_time_gt(PG_FUNCTION_ARGS)
 {
-    VersionedInt *a = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *b = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-
-    PG_RETURN_BOOL(a->entries[a->count - 1].value >
-                   b->entries[b->count - 1].value);
+    return verint_at_time_op(fcinfo, 3, VERINT_FLOAT8);
 }
 
-/* verint >= verint */
-PG_FUNCTION_INFO_V1(versioned_int_ge_versioned_int);
-Datum versioned_int_ge_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_at_time_le(PG_FUNCTION_ARGS)
 {
-    VersionedInt *a = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *b = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    return verint_at_time_op(fcinfo, 4, VERINT_FLOAT8);
+}
 
-    PG_RETURN_BOOL(a->entries[a->count - 1].value >=
-                   b->entries[b->count - 1].value);
+Datum versioned_float8_at_time_ge(PG_FUNCTION_ARGS)
+{
+    return verint_at_time_op(fcinfo, 5, VERINT_FLOAT8);
 }
 
-/* verint < verint */
-PG_FUNCTION_INFO_V1(versioned_int_lt_versioned_int);
-Datum versioned_int_lt_versioned_int(PG_FUNCTION_ARGS)
+/*
+ *
+ * Comparison of versioned_float8's current value with float8. Return
+ * null if versioned_float8 is empty. Keys order like float8 does, so
+ * comparing them is enough.
+ *
+ */
+Datum versioned_float8_eq_float8(PG_FUNCTION_ARGS)
 {
-    VersionedInt *a = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *b = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    VersionedIntEntry current;
 
-    PG_RETURN_BOOL(a->entries[a->count - 1].value <
-                   b->entries[b->count - 1].value);
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
+
+    PG_RETURN_BOOL(current.value == verfloat_key(PG_GETARG_FLOAT8(1)));
 }
 
-/* verint <= verint */
-PG_FUNCTION_INFO_V1(versioned_int_le_versioned_int);
-Datum versioned_int_le_versioned_int(PG_FUNCTION_ARGS)
+Datum versioned_float8_neq_float8(PG_FUNCTION_ARGS)
 {
-    VersionedInt *a = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *b = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
+    VersionedIntEntry current;
+
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
+        PG_RETURN_NULL();
 
-    PG_RETURN_BOOL(a->entries[a->count - 1].value <=
-                   b->entries[b->count - 1].value);
+    PG_RETURN_BOOL(current.value != verfloat_key(PG_GETARG_FLOAT8(1)));
 }
 
-/*
- *
- * ARITHMETIC OPERATORS FOR verint and bigint
- *
- */
-/* versioned_int + bigint */
-PG_FUNCTION_INFO_V1(versioned_int_add_bigint);
-Datum versioned_int_add_bigint(PG_FUNCTION_ARGS)
+Datum versioned_float8_gt_float8(PG_FUNCTION_ARGS)
 {
-    VersionedInt *vint = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 arg = PG_GETARG_INT64(1);
-    int64 result;
+    VersionedIntEntry current;
 
-    if (vint->count <= 0)
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
         PG_RETURN_NULL();
 
-    result = vint->entries[vint->count - 1].value + arg;
-    PG_RETURN_INT64(result);
+    PG_RETURN_BOOL(current.value > verfloat_key(PG_GETARG_FLOAT8(1)));
 }
 
-/* versioned_int - bigint */
-PG_FUNCTION_INFO_V1(versioned_int_sub_bigint);
-Datum versioned_int_sub_bigint(PG_FUNCTION_ARGS)
+Datum versioned_float8_ge_float8(PG_FUNCTION_ARGS)
 {
-    VersionedInt *vint = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 arg = PG_GETARG_INT64(1);
-    int64 result;
+    VersionedIntEntry current;
 
-    if (vint->count <= 0)
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
         PG_RETURN_NULL();
 
-    result = vint->entries[vint->count - 1].value - arg;
-    PG_RETURN_INT64(result);
+    PG_RETURN_BOOL(current.value >= verfloat_key(PG_GETARG_FLOAT8(1)));
 }
 
-/* versioned_int * bigint */
-PG_FUNCTION_INFO_V1(versioned_int_mul_bigint);
-Datum versioned_int_mul_bigint(PG_FUNCTION_ARGS)
+Datum versioned_float8_lt_float8(PG_FUNCTION_ARGS)
 {
-    VersionedInt *vint = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 arg = PG_GETARG_INT64(1);
-    int64 result;
+    VersionedIntEntry current;
 
-    if (vint->count <= 0)
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
         PG_RETURN_NULL();
 
-    result = vint->entries[vint->count - 1].value * arg;
-    PG_RETURN_INT64(result);
+    PG_RETURN_BOOL(current.value < verfloat_key(PG_GETARG_FLOAT8(1)));
 }
 
-/* versioned_int / bigint */
-PG_FUNCTION_INFO_V1(versioned_int_div_bigint);
-Datum versioned_int_div_bigint(PG_FUNCTION_ARGS)
+Datum versioned_float8_le_float8(PG_FUNCTION_ARGS)
 {
-    VersionedInt *vint = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    int64 arg = PG_GETARG_INT64(1);
-    int64 result;
+    VersionedIntEntry current;
 
-    if (vint->count <= 0)
+    if (!verint_fetch_last(PG_GETARG_DATUM(0), &current))
         PG_RETURN_NULL();
 
-    if (arg == 0)
-    {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("division by 0")));
-    }
+    PG_RETURN_BOOL(current.value <= verfloat_key(PG_GETARG_FLOAT8(1)));
+}
 
-    result = vint->entries[vint->count - 1].value / arg;
-    PG_RETURN_INT64(result);
+/*
+ *
+ * GiST consistent function of gist_versioned_float8_ops. Other support
+ * functions are shared with gist_versioned_int_ops, as rectangles are
+ * built over keys.
+ *
+ */
+Datum versioned_float8_consistent(PG_FUNCTION_ARGS)
+{
+    return versioned_int_consistent_internal(fcinfo, VERINT_FLOAT8);
 }
 
 /*
  *
- * ARITHMETIC OPERATORS FOR bigint and verint
+ * Returns Gorilla encoded copy of versionedInt. Split values and those
+ * carrying prefix array or value index are returned as they are.
+ * Values too large to encode stay plain, which every function reads.
  *
  */
-/* bigint + verint */
-PG_FUNCTION_INFO_V1(bigint_add_versioned_int);
-Datum bigint_add_versioned_int(PG_FUNCTION_ARGS)
+static VersionedInt *verint_xor_encode(VersionedInt *versionedInt)
 {
-    int64 arg = PG_GETARG_INT64(0);
-    VersionedInt *vint = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int64 result;
+    VersionedIntXor *xor;
+    Size size;
+    int32 i;
 
-    if (vint->count <= 0)
-        PG_RETURN_NULL();
+    if (VERINT_FLAGS(versionedInt) & (VERINT_LAYOUT_MASK | VERINT_FLAG_SPLIT | VERINT_FLAG_XOR))
+        return versionedInt;
 
-    result = arg + vint->entries[vint->count - 1].value;
-    PG_RETURN_INT64(result);
+    size = VERINT_XOR_HDRSZ + (Size)Max(versionedInt->count, 1) * VERINT_XOR_MAX_ENTRY_BYTES;
+    if (size >= (Size)MAX_VERSIONED_INT_SIZE)
+        return versionedInt;
+
+    xor = (VersionedIntXor *)palloc0(size);
+    SET_VARSIZE(xor, VERINT_XOR_HDRSZ);
+    xor->flags = VERINT_FLAG_XOR;
+    for (i = 0; i < versionedInt->count; i++)
+        verint_xor_put(xor, versionedInt->entries[i].value, versionedInt->entries[i].time);
+
+    return (VersionedInt *)xor;
 }
 
-/* bigint - verint */
-PG_FUNCTION_INFO_V1(bigint_sub_versioned_int);
-Datum bigint_sub_versioned_int(PG_FUNCTION_ARGS)
+/*
+ *
+ * Decodes Gorilla encoded value into plain versioned_int. Trimmed
+ * entries at the start of the stream are decoded and left out.
+ *
+ */
+static VersionedInt *verint_xor_decode(VersionedIntXor *xor)
 {
-    int64 arg = PG_GETARG_INT64(0);
-    VersionedInt *vint = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int64 result;
+    VersionedInt *versionedInt = verint_alloc(xor->count, xor->count, 0);
+    VerintXorState state;
+    int64 pos = 0;
+    int32 i;
 
-    if (vint->count <= 0)
-        PG_RETURN_NULL();
+    for (i = 0; i < xor->skip + xor->count; i++)
+    {
+        verint_xor_next(xor, &state, &pos, i);
+        if (i >= xor->skip)
+        {
+            versionedInt->entries[i - xor->skip].value = (int64)state.value;
+            versionedInt->entries[i - xor->skip].time = state.time;
+        }
+    }
 
-    result = arg - vint->entries[vint->count - 1].value;
-    PG_RETURN_INT64(result);
+    return versionedInt;
 }
 
-/* bigint * verint */
-PG_FUNCTION_INFO_V1(bigint_mul_versioned_int);
-Datum bigint_mul_versioned_int(PG_FUNCTION_ARGS)
+/*
+ *
+ * Returns copy of xor with entry appended to the stream. Caller makes
+ * sure time is not before the last entry's.
+ *
+ */
+static VersionedInt *verint_xor_append(VersionedIntXor *xor, int64 value, TimestampTz time)
 {
-    int64 arg = PG_GETARG_INT64(0);
-    VersionedInt *vint = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int64 result;
+    VersionedIntXor *result;
+    Size size = VARSIZE(xor) + VERINT_XOR_MAX_ENTRY_BYTES;
 
-    if (vint->count <= 0)
-        PG_RETURN_NULL();
+    if (size >= (Size)MAX_VERSIONED_INT_SIZE)
+    {
+        ereport(ERROR,
+                (errcode(ERRCODE_OUT_OF_MEMORY)),
+                errmsg("Extending column would push it pass the size of 512MB. Aborting"));
+    }
 
-    result = arg * vint->entries[vint->count - 1].value;
-    PG_RETURN_INT64(result);
+    result = (VersionedIntXor *)palloc0(size);
+    memcpy(result, xor, VARSIZE(xor));
+    verint_xor_put(result, value, time);
+
+    return (VersionedInt *)result;
 }
 
-/* bigint / verint */
-PG_FUNCTION_INFO_V1(bigint_div_versioned_int);
-Datum bigint_div_versioned_int(PG_FUNCTION_ARGS)
+/*
+ *
+ * Returns xor with only its newest keep entries. Oldest ones are only
+ * marked as skipped, without touching the stream, until skipped entries
+ * outnumber kept ones and stream is encoded again. That keeps 'N'
+ * retention of an appended value amortized constant time, with stream
+ * never longer than twice of what it holds.
+ *
+ */
+static VersionedInt *verint_xor_trim(VersionedIntXor *xor, int32 keep)
 {
-    int64 arg = PG_GETARG_INT64(0);
-    VersionedInt *vint = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int64 denominator, result;
+    VersionedIntXor *result;
+    VersionedInt *plain;
+    int32 drop;
 
-    if (vint->count <= 0)
-        PG_RETURN_NULL();
+    if (xor->count <= keep)
+        return (VersionedInt *)xor;
 
-    denominator = vint->entries[vint->count - 1].value;
-    if (denominator == 0)
+    drop = xor->count - keep;
+    if (xor->skip + drop > keep)
     {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("division by 0")));
+        plain = verint_xor_decode(xor);
+        memmove(plain->entries, plain->entries + drop, keep * sizeof(VersionedIntEntry));
+        plain->count = keep;
+        return verint_xor_encode(plain);
     }
 
-    result = arg / denominator;
-    PG_RETURN_INT64(result);
+    result = (VersionedIntXor *)palloc(VARSIZE(xor));
+    memcpy(result, xor, VARSIZE(xor));
+    result->skip += drop;
+    result->count = keep;
+    result->cap = keep;
+
+    return (VersionedInt *)result;
 }
 
 /*
  *
- * ARITHMETIC OPERATORS FOR verint and verint
+ * Writes one entry at the end of the stream. xor must have at least
+ * VERINT_XOR_MAX_ENTRY_BYTES zeroed bytes after its data. Deltas are
+ * computed in unsigned arithmetic, so they wrap around instead of
+ * overflowing for infinite timestamps, and decoding wraps them back.
  *
  */
-/* verint + verint */
-PG_FUNCTION_INFO_V1(versioned_int_add_versioned_int);
-Datum versioned_int_add_versioned_int(PG_FUNCTION_ARGS)
+static void verint_xor_put(VersionedIntXor *xor, int64 value, TimestampTz time)
 {
-    VersionedInt *vint1 = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *vint2 = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int64 result;
+    VerintXorState *state = &xor->state;
+    int64 pos = xor->nbits;
+    uint64 bits = (uint64)value;
+    uint64 diff, zigzag;
+    int64 delta, dod;
+    int32 leading, trailing;
+
+    if (xor->skip + xor->count == 0)
+    {
+        verint_xor_put_bits(xor->data, &pos, (uint64)time, 64);
+        verint_xor_put_bits(xor->data, &pos, bits, 64);
+        state->delta = 0;
+        state->leading = -1;
+        state->trailing = -1;
+    }
+    else
+    {
+        delta = (int64)((uint64)time - (uint64)state->time);
+        dod = (int64)((uint64)delta - (uint64)state->delta);
+        zigzag = ((uint64)dod << 1) ^ (uint64)(dod >> 63);
 
-    if (vint1->count <= 0 || vint2->count <= 0)
-        PG_RETURN_NULL();
+        if (zigzag == 0)
+            verint_xor_put_bits(xor->data, &pos, 0x0, 1);
+        else if (zigzag < ((uint64)1 << 14))
+        {
+            verint_xor_put_bits(xor->data, &pos, 0x2, 2);
+            verint_xor_put_bits(xor->data, &pos, zigzag, 14);
+        }
+        else if (zigzag < ((uint64)1 << 24))
+        {
+            verint_xor_put_bits(xor->data, &pos, 0x6, 3);
+            verint_xor_put_bits(xor->data, &pos, zigzag, 24);
+        }
+        else if (zigzag < ((uint64)1 << 36))
+        {
+            verint_xor_put_bits(xor->data, &pos, 0xE, 4);
+            verint_xor_put_bits(xor->data, &pos, zigzag, 36);
+        }
+        else
+        {
+            verint_xor_put_bits(xor->data, &pos, 0xF, 4);
+            verint_xor_put_bits(xor->data, &pos, zigzag, 64);
+        }
+        state->delta = delta;
 
-    result = vint1->entries[vint1->count - 1].value + vint2->entries[vint2->count - 1].value;
-    PG_RETURN_INT64(result);
+        diff = bits ^ state->value;
+        if (diff == 0)
+            verint_xor_put_bits(xor->data, &pos, 0x0, 1);
+        else
+        {
+            leading = 63 - pg_leftmost_one_pos64(diff);
+            trailing = pg_rightmost_one_pos64(diff);
+
+            if (state->leading >= 0 && leading >= state->leading && trailing >= state->trailing)
+            {
+                verint_xor_put_bits(xor->data, &pos, 0x2, 2);
+                verint_xor_put_bits(xor->data, &pos, diff >> state->trailing,
+                                    64 - state->leading - state->trailing);
+            }
+            else
+            {
+                verint_xor_put_bits(xor->data, &pos, 0x3, 2);
+                verint_xor_put_bits(xor->data, &pos, leading, 6);
+                verint_xor_put_bits(xor->data, &pos, 63 - leading - trailing, 6);
+                verint_xor_put_bits(xor->data, &pos, diff >> trailing, 64 - leading - trailing);
+                state->leading = leading;
+                state->trailing = trailing;
+            }
+        }
+    }
+
+    state->time = time;
+    state->value = bits;
+    xor->count += 1;
+    xor->cap = xor->count;
+    xor->nbits = pos;
+    SET_VARSIZE(xor, VERINT_XOR_HDRSZ + (pos + 7) / 8);
 }
 
-/* verint - verint */
-PG_FUNCTION_INFO_V1(versioned_int_sub_versioned_int);
-Datum versioned_int_sub_versioned_int(PG_FUNCTION_ARGS)
+/*
+ *
+ * Decodes i-th entry of the stream, counting skipped ones, into state,
+ * which must hold state after entry i - 1. pos is advanced past the
+ * entry.
+ *
+ */
+static void verint_xor_next(const VersionedIntXor *xor, VerintXorState *state, int64 *pos, int32 i)
 {
-    VersionedInt *vint1 = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *vint2 = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int64 result;
+    const uint8 *data = xor->data;
+    uint64 zigzag, diff;
+    int64 dod;
+    int32 length;
 
-    if (vint1->count <= 0 || vint2->count <= 0)
-        PG_RETURN_NULL();
+    if (i == 0)
+    {
+        state->time = (TimestampTz)verint_xor_get_bits(data, pos, 64);
+        state->value = verint_xor_get_bits(data, pos, 64);
+        state->delta = 0;
+        state->leading = -1;
+        state->trailing = -1;
+        return;
+    }
 
-    result = vint1->entries[vint1->count - 1].value - vint2->entries[vint2->count - 1].value;
-    PG_RETURN_INT64(result);
-}
+    if (verint_xor_get_bits(data, pos, 1) == 0)
+        zigzag = 0;
+    else if (verint_xor_get_bits(data, pos, 1) == 0)
+        zigzag = verint_xor_get_bits(data, pos, 14);
+    else if (verint_xor_get_bits(data, pos, 1) == 0)
+        zigzag = verint_xor_get_bits(data, pos, 24);
+    else if (verint_xor_get_bits(data, pos, 1) == 0)
+        zigzag = verint_xor_get_bits(data, pos, 36);
+    else
+        zigzag = verint_xor_get_bits(data, pos, 64);
 
-/* verint * verint */
-PG_FUNCTION_INFO_V1(versioned_int_mul_versioned_int);
-Datum versioned_int_mul_versioned_int(PG_FUNCTION_ARGS)
-{
-    VersionedInt *vint1 = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *vint2 = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int64 result;
+    dod = (int64)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+    state->delta = (int64)((uint64)state->delta + (uint64)dod);
+    state->time = (TimestampTz)((uint64)state->time + (uint64)state->delta);
 
-    if (vint1->count <= 0 || vint2->count <= 0)
-        PG_RETURN_NULL();
+    if (verint_xor_get_bits(data, pos, 1) == 1)
+    {
+        if (verint_xor_get_bits(data, pos, 1) == 1)
+        {
+            state->leading = (int32)verint_xor_get_bits(data, pos, 6);
+            length = (int32)verint_xor_get_bits(data, pos, 6) + 1;
+            state->trailing = 64 - state->leading - length;
+        }
 
-    result = vint1->entries[vint1->count - 1].value * vint2->entries[vint2->count - 1].value;
-    PG_RETURN_INT64(result);
+        diff = verint_xor_get_bits(data, pos, 64 - state->leading - state->trailing) << state->trailing;
+        state->value ^= diff;
+    }
 }
 
-/* verint / verint */
-PG_FUNCTION_INFO_V1(versioned_int_div_versioned_int);
-Datum versioned_int_div_versioned_int(PG_FUNCTION_ARGS)
+/*
+ *
+ * Writes n lowest bits of bits at bit position pos of buf, most
+ * significant first. Target bits must be zero.
+ *
+ */
+static void verint_xor_put_bits(uint8 *buf, int64 *pos, uint64 bits, int n)
 {
-    VersionedInt *vint1 = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(0));
-    VersionedInt *vint2 = (VersionedInt *)PG_DETOAST_DATUM(PG_GETARG_DATUM(1));
-    int64 denominator, result;
+    int avail, chunk;
 
-    if (vint1->count <= 0 || vint2->count <= 0)
-        PG_RETURN_NULL();
+    while (n > 0)
+    {
+        avail = 8 - (int)(*pos & 7);
+        chunk = Min(avail, n);
+        buf[*pos >> 3] |= (uint8)(((bits >> (n - chunk)) & ((1 << chunk) - 1)) << (avail - chunk));
+        *pos += chunk;
+        n -= chunk;
+    }
+}
 
-    denominator = vint2->entries[vint2->count - 1].value;
-    if (denominator == 0)
+static uint64 verint_xor_get_bits(const uint8 *buf, int64 *pos, int n)
+{
+    uint64 result = 0;
+    int avail, chunk;
+
+    while (n > 0)
     {
-        ereport(ERROR,
-                (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-                 errmsg("division by 0")));
+        avail = 8 - (int)(*pos & 7);
+        chunk = Min(avail, n);
+        result = (result << chunk) | ((buf[*pos >> 3] >> (avail - chunk)) & ((1 << chunk) - 1));
+        *pos += chunk;
+        n -= chunk;
     }
 
-    result = vint1->entries[vint1->count - 1].value / denominator;
-    PG_RETURN_INT64(result);
-}
\ No newline at end of file
+    return result;
+}